@@ -1,215 +1,1420 @@
 #include "ai.h"
+#include "book.h"
+#include "pns.h"
+#include "profile.h"
+#include "tablebase.h"
+#include "trace.h"
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace {
+// Вертикали y == 0 и y == board_size - 1
+constexpr uint64_t kFirstFile = 0x0101010101010101ULL;
+constexpr uint64_t kLastFile = kFirstFile << (board_size - 1);
+
+constexpr uint64_t triangleMask(bool nearOrigin) {
+  uint64_t mask = 0;
+  for (int x = 0; x < board_size; ++x)
+    for (int y = 0; y < board_size; ++y)
+      if (nearOrigin ? x + y <= corner_size - 1
+                     : x + y >= 2 * board_size - corner_size - 1)
+        mask |= 1ULL << (x * board_size + y);
+  return mask;
+}
+
+// Целевые треугольники: чёрные идут к (0, 0), белые к (7, 7)
+constexpr uint64_t kBlackTarget = triangleMask(true);
+constexpr uint64_t kWhiteTarget = triangleMask(false);
+
+// Ключи Зобриста генерируются при компиляции из фиксированного зерна,
+// поэтому совпадают во всех сборках. Запертые фишки отдельно не хешируются:
+// заперты ровно фишки, стоящие в своём целевом углу
+constexpr uint64_t splitMix64(uint64_t &state) {
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+struct ZobristKeys {
+  uint64_t piece[2][64];
+  uint64_t blackMoves[64];
+  uint64_t whiteMoves[64];
+  uint64_t blackToMove;
+
+  constexpr ZobristKeys()
+      : piece(), blackMoves(), whiteMoves(), blackToMove() {
+    uint64_t state = 20240601;
+    for (auto &colour : piece)
+      for (uint64_t &k : colour)
+        k = splitMix64(state);
+    for (uint64_t &k : blackMoves)
+      k = splitMix64(state);
+    for (uint64_t &k : whiteMoves)
+      k = splitMix64(state);
+    blackToMove = splitMix64(state);
+  }
+};
+
+constexpr ZobristKeys kZobrist;
+
+inline const uint64_t *pieceKeys(char player) {
+  return kZobrist.piece[colourIndex(player)];
+}
+
+// Таблицы «фишка-клетка» (в пользу чёрных): 10 очков за каждую клетку
+// расстояния до целевого угла и 50 за клетку внутри него. Оценка позиции
+// складывается из них и обновляется ходом за O(1)
+struct PieceSquareTables {
+  int value[2][64];
+
+  constexpr PieceSquareTables() : value() {
+    for (int x = 0; x < board_size; ++x)
+      for (int y = 0; y < board_size; ++y) {
+        int sq = x * board_size + y;
+        value[0][sq] = distanceToCorner(x, y, 'W') * 10 -
+                       (((kWhiteTarget >> sq) & 1) ? 50 : 0);
+        value[1][sq] = -distanceToCorner(x, y, 'B') * 10 +
+                       (((kBlackTarget >> sq) & 1) ? 50 : 0);
+      }
+  }
+};
+
+constexpr PieceSquareTables kPieceSquare;
+
+inline const int *pieceSquare(char player) {
+  return kPieceSquare.value[colourIndex(player)];
+}
+
+inline uint64_t targetMask(char player) {
+  return player == 'W' ? kWhiteTarget : kBlackTarget;
+}
+
+// Направления: x + 1, x - 1, y + 1, y - 1 и соответствующие смещения индекса
+constexpr int kDirOffset[4] = {board_size, -board_size, 1, -1};
+
+inline uint64_t shift(uint64_t b, int dir) {
+  switch (dir) {
+  case 0:
+    return b << board_size;
+  case 1:
+    return b >> board_size;
+  case 2:
+    return (b & ~kLastFile) << 1;
+  default:
+    return (b & ~kFirstFile) >> 1;
+  }
+}
+
+// Все клетки, куда фишка с клетки from доходит цепочкой прыжков. Заливка
+// идёт по фронту: каждая клетка попадает в результат один раз, сколькими
+// бы путями до неё ни добраться. Сама фишка уже покинула from
+uint64_t jumpDestinations(uint64_t occupied, int from) {
+  const uint64_t start = 1ULL << from;
+  const uint64_t others = occupied & ~start;
+  const uint64_t free = ~others;
+  uint64_t reached = start, frontier = start;
+  while (frontier) {
+    uint64_t next = 0;
+    for (int dir = 0; dir < 4; dir++)
+      next |= shift(shift(frontier, dir) & others, dir) & free;
+    frontier = next & ~reached;
+    reached |= frontier;
+  }
+  return reached & ~start;
+}
+} // namespace
+
+char Position::at(int x, int y) const {
+  uint64_t bit = squareBit(x, y);
+  if (white & bit)
+    return 'W';
+  if (black & bit)
+    return 'B';
+  return '.';
+}
+
+void Position::set(int x, int y, char piece) {
+  int sq = square(x, y);
+  uint64_t bit = 1ULL << sq;
+  for (char player : {'W', 'B'})
+    if (pieces(player) & bit) {
+      key ^= pieceKeys(player)[sq];
+      score -= pieceSquare(player)[sq];
+      if (targetMask(player) & bit)
+        --home[colourIndex(player)];
+    }
+  white &= ~bit;
+  black &= ~bit;
+  locked &= ~bit;
+  if (piece != 'W' && piece != 'B')
+    return;
+  (piece == 'W' ? white : black) |= bit;
+  key ^= pieceKeys(piece)[sq];
+  score += pieceSquare(piece)[sq];
+  if (targetMask(piece) & bit) {
+    locked |= bit;
+    ++home[colourIndex(piece)];
+  }
+}
 
-// Глобальные переменные (определение)
-const int board_size = 8;
-const int corner_size = 4;
-std::vector<std::vector<char>> board(board_size,
-                                     std::vector<char>(board_size, '.'));
-std::vector<std::vector<bool>>
-    inOpponentCorner(board_size, std::vector<bool>(board_size, false));
-int blackMoves = 20;
-int whiteMoves = 20;
-std::vector<std::string> moveHistory;
-size_t moveNumber = 0;
+uint64_t positionKey(const Position &pos, char player, int remainingBlackMoves,
+                     int remainingWhiteMoves) {
+  return pos.key ^ kZobrist.blackMoves[remainingBlackMoves & 63] ^
+         kZobrist.whiteMoves[remainingWhiteMoves & 63] ^
+         (player == 'B' ? kZobrist.blackToMove : 0);
+}
 
 // Вспомогательные функции: isInside, isValidMove, makeMove, checkWin
 bool isInside(int x, int y) {
   return x >= 0 && x < board_size && y >= 0 && y < board_size;
 }
 
-bool isValidMove(int x1, int y1, int x2, int y2, char player) {
+bool isValidMove(const Position &pos, int x1, int y1, int x2, int y2,
+                 char player) {
+  UGOLKI_PROFILE_SCOPE(IsValidMove);
   if (!isInside(x1, y1) || !isInside(x2, y2))
     return false;
-  if (board[x1][y1] != player || board[x2][y2] != '.')
+  uint64_t from = squareBit(x1, y1), to = squareBit(x2, y2);
+  if (!(pos.pieces(player) & from) || (pos.occupied() & to))
     return false;
-  if (player == 'B' && inOpponentCorner[x1][y1])
+  if (pos.locked & from)
     return false;
 
   int dx = abs(x2 - x1), dy = abs(y2 - y1);
   if ((dx == 1 && dy == 0) || (dx == 0 && dy == 1))
     return true;
-  if ((dx == 2 && dy == 0) || (dx == 0 && dy == 2)) {
-    int mx = (x1 + x2) / 2, my = (y1 + y2) / 2;
-    if (board[mx][my] != '.')
-      return true;
-  }
-  return false;
+  // одиночный прыжок или цепочка прыжков
+  return (jumpDestinations(pos.occupied(), square(x1, y1)) & to) != 0;
 }
 
-bool makeMove(int x1, int y1, int x2, int y2, char player) {
-  if (!isValidMove(x1, y1, x2, y2, player))
+bool makeMove(Position &pos, int x1, int y1, int x2, int y2, char player) {
+  if (!isValidMove(pos, x1, y1, x2, y2, player))
     return false;
-  board[x2][y2] = player;
-  board[x1][y1] = '.';
-  if (player == 'B' && x2 <= 3 && y2 <= 3 - x2)
-    inOpponentCorner[x2][y2] = true;
+  Undo undo;
+  makeMove(pos, Move(x1, y1, x2, y2), player, undo);
   return true;
 }
 
-bool checkWin(char player) {
-  int count = 0;
-  if (player == 'W') {
-    for (int x = board_size - corner_size; x < board_size; ++x)
-      for (int y = board_size - corner_size; y < board_size; ++y)
-        if ((x + y) >= board_size - 1 + board_size - corner_size &&
-            board[x][y] == 'W')
-          ++count;
-    return count >= 6;
-  } else {
-    for (int x = 0; x < corner_size; ++x)
-      for (int y = 0; y < corner_size; ++y)
-        if ((x + y) <= corner_size - 1 && board[x][y] == 'B')
-          ++count;
-    return count >= 6;
+// Ход без проверки: для поиска, где ходы уже получены из generateMoves.
+// Фишка любого цвета, дошедшая до своего целевого угла, запирается
+void makeMove(Position &pos, const Move &m, char player, Undo &undo) {
+  undo.from = static_cast<uint8_t>(m.from());
+  undo.to = static_cast<uint8_t>(m.to());
+  uint64_t toBit = 1ULL << undo.to;
+  uint64_t fromTo = (1ULL << undo.from) | toBit;
+  if (player == 'W')
+    pos.white ^= fromTo;
+  else
+    pos.black ^= fromTo;
+  pos.key ^= pieceKeys(player)[undo.from] ^ pieceKeys(player)[undo.to];
+  pos.score += pieceSquare(player)[undo.to] - pieceSquare(player)[undo.from];
+  undo.locked = (toBit & targetMask(player)) != 0;
+  if (undo.locked) {
+    pos.locked |= toBit;
+    ++pos.home[colourIndex(player)];
   }
-  return false;
 }
 
-// AI функции
-int distanceToCorner(int x, int y, char player) {
-  int targetX = (player == 'B') ? 0 : board_size - 1;
-  int targetY = (player == 'B') ? 0 : board_size - 1;
-  return abs(targetX - x) + abs(targetY - y);
+void unmakeMove(Position &pos, const Undo &undo, char player) {
+  uint64_t toBit = 1ULL << undo.to;
+  uint64_t fromTo = (1ULL << undo.from) | toBit;
+  if (undo.locked) {
+    pos.locked &= ~toBit;
+    --pos.home[colourIndex(player)];
+  }
+  if (player == 'W')
+    pos.white ^= fromTo;
+  else
+    pos.black ^= fromTo;
+  pos.key ^= pieceKeys(player)[undo.from] ^ pieceKeys(player)[undo.to];
+  pos.score -= pieceSquare(player)[undo.to] - pieceSquare(player)[undo.from];
 }
 
-int evaluateBoard(const std::vector<std::vector<char>> &boardState,
-                  int remainingBlackMoves, int remainingWhiteMoves) {
-  int score = 0;
-  for (int x = 0; x < board_size; ++x)
-    for (int y = 0; y < board_size; ++y) {
-      if (boardState[x][y] == 'B') {
-        score -= distanceToCorner(x, y, 'B') * 10;
-        if (x <= 3 && y <= 3 && (x + y) <= corner_size - 1)
-          score += 50;
-      } else if (boardState[x][y] == 'W') {
-        score += distanceToCorner(x, y, 'W') * 10;
-        if (x >= board_size - 4 && y >= board_size - 4 &&
-            (x + y) >= 2 * board_size - corner_size - 1)
-          score -= 50;
-      }
-    }
+bool checkWin(const Position &pos, char player) {
+  UGOLKI_PROFILE_SCOPE(CheckWin);
+  return piecesHome(pos, player) >= 6;
+}
+
+uint64_t targetSquares(char player) { return targetMask(player); }
+
+// AI функции
+int evaluateBoard(const Position &pos, int remainingBlackMoves,
+                  int remainingWhiteMoves) {
+  UGOLKI_PROFILE_SCOPE(EvaluateBoard);
+  int score = pos.score;
   if (remainingBlackMoves <= 5)
-    for (int x = 0; x < corner_size; ++x)
-      for (int y = 0; y < corner_size; ++y)
-        if ((x + y) <= corner_size - 1 && boardState[x][y] != 'B')
-          score -= 20;
+    score -= (pieces_per_side - piecesHome(pos, 'B')) * 20;
+  if (remainingWhiteMoves <= 5)
+    score += (pieces_per_side - piecesHome(pos, 'W')) * 20;
   return score;
 }
 
-std::vector<Move> generateMoves(char player) {
-  std::vector<Move> moves;
-  const int dxs[4] = {1, -1, 0, 0};
-  const int dys[4] = {0, 0, 1, -1};
-  for (int x = 0; x < board_size; x++)
-    for (int y = 0; y < board_size; y++)
-      if (board[x][y] == player)
-        for (int dir = 0; dir < 4; dir++) {
-          int nx = x + dxs[dir], ny = y + dys[dir];
-          if (isValidMove(x, y, nx, ny, player))
-            moves.push_back({x, y, nx, ny});
-          nx = x + 2 * dxs[dir];
-          ny = y + 2 * dys[dir];
-          if (isValidMove(x, y, nx, ny, player))
-            moves.push_back({x, y, nx, ny});
-        }
+// Шаги строятся сдвигами сразу для всех фишек, прыжки — заливкой для каждой
+// фишки: один ход на каждую достижимую клетку, а не на каждый путь к ней
+MoveList generateMoves(const Position &pos, char player) {
+  MoveList moves;
+  generateMoves(pos, player, moves);
   return moves;
 }
 
-int minimax(int depth, bool isMaximizing, int alpha, int beta,
-            int remainingBlackMoves, int remainingWhiteMoves) {
-  if (depth == 0 || checkWin('B') || checkWin('W'))
-    return evaluateBoard(board, remainingBlackMoves, remainingWhiteMoves);
+void generateMoves(const Position &pos, char player, MoveList &moves) {
+  UGOLKI_PROFILE_SCOPE(GenerateMoves);
+  moves.clear();
+  const uint64_t own = pos.pieces(player) & ~pos.locked;
+  const uint64_t occupied = pos.occupied();
+  const uint64_t empty = ~occupied;
+  for (int dir = 0; dir < 4; dir++) {
+    for (uint64_t steps = shift(own, dir) & empty; steps; steps &= steps - 1) {
+      int to = lsb(steps);
+      moves.push_back(Move(to - kDirOffset[dir], to));
+    }
+  }
+  // прыжок меняет координату на 2, поэтому его цели не совпадают с шагами
+  for (uint64_t pieces = own; pieces; pieces &= pieces - 1) {
+    int from = lsb(pieces);
+    for (uint64_t jumps = jumpDestinations(occupied, from); jumps;
+         jumps &= jumps - 1) {
+      moves.push_back(Move(from, lsb(jumps)));
+    }
+  }
+}
 
-  char player = isMaximizing ? 'B' : 'W';
-  std::vector<Move> moves = generateMoves(player);
-  if (moves.empty())
-    return evaluateBoard(board, remainingBlackMoves, remainingWhiteMoves);
-
-  if (isMaximizing) {
-    int maxEval = -1000000;
-    for (auto &m : moves) {
-      auto backupBoard = board;
-      auto backupCorner = inOpponentCorner;
-      makeMove(m.x1, m.y1, m.x2, m.y2, player);
-      int eval = minimax(depth - 1, false, alpha, beta, remainingBlackMoves - 1,
-                         remainingWhiteMoves);
-      board = backupBoard;
-      inOpponentCorner = backupCorner;
-      maxEval = std::max(maxEval, eval);
-      alpha = std::max(alpha, eval);
-      if (beta <= alpha)
+namespace {
+// Как часто (в узлах) сверяться с часами
+constexpr uint64_t kTimeCheckMask = 1023;
+
+// Оценка вне любых достижимых значений evaluateBoard
+constexpr int kInfinity = 1000000;
+// Полуширина окна аспирации и глубина, с которой оно включается
+constexpr int kAspirationWindow = 30;
+constexpr int kAspirationMinDepth = 4;
+
+// Ступени упорядочивания ходов; значения истории держатся ниже kKillerScore
+constexpr int kTTMoveScore = 1 << 30;
+constexpr int kJumpScore = 1 << 26;
+constexpr int kKillerScore = 1 << 25;
+constexpr int kHistoryLimit = 1 << 24;
+
+// Прыжок (или цепочка), приближающий фишку к целевому углу; gain —
+// выигрыш по таблице «фишка-клетка» с точки зрения player
+bool isForwardJump(Move m, char player, int &gain) {
+  const int *table = pieceSquare(player);
+  gain = (player == 'B' ? 1 : -1) * (table[m.to()] - table[m.from()]);
+  int dx = abs(m.x2() - m.x1()), dy = abs(m.y2() - m.y1());
+  return dx + dy > 1 && gain > 0;
+}
+
+// Оценка выигрыша по таблицам эндшпиля: выше любой эвристической,
+// быстрый выигрыш (и долгий проигрыш) предпочтительнее
+constexpr int kTablebaseWin = 100000;
+
+int tablebaseScore(const TablebaseResult &result) {
+  if (result.wdl > 0)
+    return kTablebaseWin - result.distance;
+  if (result.wdl < 0)
+    return -kTablebaseWin + result.distance;
+  return 0;
+}
+
+// Точный перебор хранит в таблице транспозиций итог партии, а не оценку,
+// поэтому его ключи отличаются от ключей поиска
+constexpr uint64_t kSolverKey = 0x9E3779B97F4A7C15ULL;
+// Дальше этого горизонта (оставшихся ходов обеих сторон) перебор не
+// пробуется: он заведомо не уложится в бюджет
+constexpr int kSolverMaxPlies = 12;
+// Доказательство выигрыша пробуется до этого горизонта
+constexpr int kProofMaxPlies = 24;
+
+// Итог партии в шкале оценок: победа и поражение — за пределами
+// эвристических оценок, при одном исходе лучше больший перевес
+int solvedScore(int margin) {
+  if (margin > 0)
+    return kTablebaseWin + margin;
+  if (margin < 0)
+    return -kTablebaseWin + margin;
+  return 0;
+}
+
+// YBWC: узлы мельче этой глубины перебираются одним потоком
+constexpr int kSplitMinDepth = 3;
+
+// Сроки поиска хранятся в тиках steady_clock, чтобы их можно было сдвинуть
+// из другого потока (попадание при размышлении); kNoDeadline — без срока
+constexpr int64_t kNoDeadline = INT64_MAX;
+
+int64_t ticksNow() {
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+double millisecondsSince(int64_t startTicks) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::duration(ticksNow() - startTicks))
+      .count();
+}
+
+int64_t ticksAfter(int milliseconds) {
+  using namespace std::chrono;
+  return ticksNow() +
+         duration_cast<steady_clock::duration>(
+             std::chrono::milliseconds(milliseconds))
+             .count();
+}
+
+// Выбор очередного хода: лучший из оставшихся переставляется на место i
+void pickNextMove(MoveList &moves, int *scores, int i) {
+  int best = i;
+  for (int j = i + 1; j < moves.size(); ++j)
+    if (scores[j] > scores[best])
+      best = j;
+  std::swap(moves[i], moves[best]);
+  std::swap(scores[i], scores[best]);
+}
+
+// Помощники Lazy SMP перебирают тихие ходы каждый в своём порядке:
+// добавка 0..15 к истории, зависящая от зерна потока и хода, переставляет
+// ходы с равной или почти равной историей, и потоки реже повторяют
+// поддеревья друг друга
+int orderNoise(uint32_t seed, Move m) {
+  if (seed == 0)
+    return 0;
+  return int(((m.data * 0x9E3779B1u) ^ seed) * 0x85EBCA6Bu >> 28);
+}
+} // namespace
+
+void SearchStats::merge(const SearchStats &other) {
+  nodes += other.nodes;
+  leafEvals += other.leafEvals;
+  cutoffs += other.cutoffs;
+  firstMoveCutoffs += other.firstMoveCutoffs;
+  ttProbes += other.ttProbes;
+  ttHits += other.ttHits;
+  ttCutoffs += other.ttCutoffs;
+  tablebaseHits += other.tablebaseHits;
+  proofNodes += other.proofNodes;
+  selDepth = std::max(selDepth, other.selDepth);
+  hardware.merge(other.hardware);
+}
+
+double SearchStats::nodesPerSecond() const {
+  return timeMs > 0 ? nodes * 1000.0 / timeMs : 0.0;
+}
+
+double SearchStats::firstMoveCutoffRate() const {
+  return cutoffs ? double(firstMoveCutoffs) / double(cutoffs) : 0.0;
+}
+
+double SearchStats::effectiveBranchingFactor() const {
+  if (iterations < 2 || iterationNodes[iterations - 2] == 0)
+    return 0.0;
+  return double(iterationNodes[iterations - 1]) /
+         double(iterationNodes[iterations - 2]);
+}
+
+void Engine::scoreMoves(const SearchWorker &w, const MoveList &moves,
+                        char player, Move ttMove, int ply, int *scores) const {
+  const int(&history)[64][64] = w.history[colourIndex(player)];
+  for (int i = 0; i < moves.size(); ++i) {
+    Move m = moves[i];
+    int gain;
+    if (m == ttMove)
+      scores[i] = kTTMoveScore;
+    else if (isForwardJump(m, player, gain))
+      scores[i] = kJumpScore + gain;
+    else if (m == w.killers[ply][0])
+      scores[i] = kKillerScore + 1;
+    else if (m == w.killers[ply][1])
+      scores[i] = kKillerScore;
+    else
+      scores[i] = history[m.from()][m.to()] + orderNoise(w.orderSeed, m);
+  }
+}
+
+// Тихий ход, давший отсечение, становится убийцей этого полухода
+// и получает прибавку в таблице истории
+void Engine::updateQuietCutoff(SearchWorker &w, Move m, char player, int depth,
+                               int ply) {
+  if (w.killers[ply][0] != m) {
+    w.killers[ply][1] = w.killers[ply][0];
+    w.killers[ply][0] = m;
+  }
+  int &entry = w.history[colourIndex(player)][m.from()][m.to()];
+  entry += depth * depth;
+  if (entry >= kHistoryLimit)
+    for (auto &colour : w.history)
+      for (auto &row : colour)
+        for (int &value : row)
+          value /= 2;
+}
+
+// Точка разделения YBWC: узел, первый ход которого владелец уже перебрал
+// сам. Остальные ходы разбирают владелец и присоединившиеся помощники
+struct SplitPoint {
+  const SplitPoint *parent = nullptr;
+  Position pos;
+  MoveList *moves = nullptr;
+  int *scores = nullptr;
+  char player = 'B';
+  int depth = 0, ply = 0;
+  int remainingBlackMoves = 0, remainingWhiteMoves = 0;
+  int beta = 0;
+  bool pvNode = false;
+
+  // Поля ниже меняются только под lock
+  std::mutex lock;
+  int next = 0;
+  int alpha = 0;
+  int bestScore = 0;
+  Move bestMove;
+  // лучший вариант от этого узла, если ход поднял alpha
+  Move pv[max_search_depth];
+  int pvLength = 0;
+
+  std::atomic<bool> cutoff{false};
+  std::atomic<int> helpers{0};
+};
+
+Engine::Engine() : pns_(new ProofNumberSearch) {
+  setThreads(1);
+  // вариант не длиннее глубины поиска: поиск не обращается к куче
+  rootPv_.reserve(max_search_depth);
+  // буфер проб потока, создавшего движок, — тоже часть инициализации
+  registerProfileThread();
+}
+
+void Engine::setProofHashSizeMb(size_t sizeMb) { pns_->setHashSizeMb(sizeMb); }
+
+void Engine::setThreads(int count) {
+  count = std::max(1, count);
+  workers_.resize(count);
+  for (int i = 0; i < count; ++i) {
+    if (!workers_[i])
+      workers_[i].reset(new SearchWorker);
+    workers_[i]->id = i;
+    workers_[i]->orderSeed = i == 0 ? 0 : uint32_t(i) * 0x9E3779B9u;
+  }
+}
+
+bool Engine::shouldStop(const SearchWorker &w) const {
+  if (stop_.load(std::memory_order_relaxed))
+    return true;
+  // отсечение в любой точке разделения выше делает эту работу ненужной
+  for (const SplitPoint *sp = w.activeSplit; sp; sp = sp->parent)
+    if (sp->cutoff.load(std::memory_order_relaxed))
+      return true;
+  return false;
+}
+
+bool Engine::canSplit(const SearchWorker &w, int depth) const {
+  return mode_ == ParallelMode::Ybwc && depth >= kSplitMinDepth &&
+         idleHelpers_.load(std::memory_order_relaxed) > 0 &&
+         w.splitCount < max_search_depth;
+}
+
+void Engine::searchSplitPoint(SearchWorker &w, SplitPoint &sp) {
+  const SplitPoint *saved = w.activeSplit;
+  w.activeSplit = &sp;
+  Position pos = sp.pos;
+  const char opponent = sp.player == 'B' ? 'W' : 'B';
+  const int childBlack = sp.remainingBlackMoves - (sp.player == 'B' ? 1 : 0);
+  const int childWhite = sp.remainingWhiteMoves - (sp.player == 'W' ? 1 : 0);
+  const int ply = sp.ply;
+  for (;;) {
+    Move m;
+    int alpha;
+    bool first;
+    {
+      std::lock_guard<std::mutex> guard(sp.lock);
+      if (sp.next >= sp.moves->size() ||
+          sp.cutoff.load(std::memory_order_relaxed))
         break;
+      pickNextMove(*sp.moves, sp.scores, sp.next);
+      m = (*sp.moves)[sp.next];
+      first = sp.next++ == 0;
+      alpha = sp.alpha;
     }
-    return maxEval;
-  } else {
-    int minEval = 1000000;
-    for (auto &m : moves) {
-      auto backupBoard = board;
-      auto backupCorner = inOpponentCorner;
-      makeMove(m.x1, m.y1, m.x2, m.y2, player);
-      int eval = minimax(depth - 1, true, alpha, beta, remainingBlackMoves,
-                         remainingWhiteMoves - 1);
-      board = backupBoard;
-      inOpponentCorner = backupCorner;
-      minEval = std::min(minEval, eval);
-      beta = std::min(beta, eval);
-      if (beta <= alpha)
-        break;
+
+    if (ply == 0)
+      UGOLKI_TRACE_BEGIN(RootMove, m.data);
+    Undo undo;
+    makeMove(pos, m, sp.player, undo);
+    int score = -search(w, pos, sp.depth - 1, ply + 1, opponent, -alpha - 1,
+                        -alpha, childBlack, childWhite);
+    if (score > alpha && score < sp.beta)
+      score = -search(w, pos, sp.depth - 1, ply + 1, opponent, -sp.beta,
+                      -alpha, childBlack, childWhite);
+    unmakeMove(pos, undo, sp.player);
+    if (ply == 0)
+      UGOLKI_TRACE_END(RootMove, m.data);
+    if (shouldStop(w))
+      break;
+
+    std::lock_guard<std::mutex> guard(sp.lock);
+    if (score > sp.bestScore) {
+      sp.bestScore = score;
+      sp.bestMove = m;
+      if (score > sp.alpha) {
+        sp.alpha = score;
+        if (sp.pvNode) {
+          sp.pv[0] = m;
+          int length = std::max(ply + 1, w.pvLength[ply + 1]);
+          for (int k = ply + 1; k < length; ++k)
+            sp.pv[k - ply] = w.pv[ply + 1][k];
+          sp.pvLength = length - ply;
+        }
+      }
+    }
+    if (sp.alpha >= sp.beta && !sp.cutoff.load(std::memory_order_relaxed)) {
+      sp.cutoff.store(true, std::memory_order_relaxed);
+      ++w.stats.cutoffs;
+      if (first)
+        ++w.stats.firstMoveCutoffs;
+      int gain;
+      if (!isForwardJump(m, sp.player, gain))
+        updateQuietCutoff(w, m, sp.player, sp.depth, ply);
     }
-    return minEval;
   }
+  w.activeSplit = saved;
 }
 
-#include <chrono>
+SplitPoint *Engine::stealSplitPoint(SearchWorker &thief) {
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    SearchWorker &victim = *workers_[(thief.id + 1 + i) % workers_.size()];
+    if (&victim == &thief)
+      continue;
+    std::lock_guard<std::mutex> guard(victim.splitMutex);
+    // старые точки лежат ближе к корню, их поддеревья крупнее
+    for (int k = 0; k < victim.splitCount; ++k) {
+      SplitPoint *sp = victim.splits[k];
+      std::lock_guard<std::mutex> spGuard(sp->lock);
+      if (sp->next < sp->moves->size() &&
+          !sp->cutoff.load(std::memory_order_relaxed)) {
+        sp->helpers.fetch_add(1, std::memory_order_relaxed);
+        return sp;
+      }
+    }
+  }
+  return nullptr;
+}
 
-bool makeAIMove() {
-  std::vector<Move> moves = generateMoves('B');
-  if (moves.empty())
-    return false;
+void Engine::helperLoop(SearchWorker &w) {
+  idleHelpers_.fetch_add(1, std::memory_order_relaxed);
+  while (!stop_.load(std::memory_order_relaxed)) {
+    SplitPoint *sp = stealSplitPoint(w);
+    if (!sp) {
+      std::this_thread::yield();
+      continue;
+    }
+    idleHelpers_.fetch_sub(1, std::memory_order_relaxed);
+    UGOLKI_TRACE_BEGIN(SplitPoint, sp->ply);
+    searchSplitPoint(w, *sp);
+    UGOLKI_TRACE_END(SplitPoint, sp->ply);
+    sp->helpers.fetch_sub(1, std::memory_order_release);
+    idleHelpers_.fetch_add(1, std::memory_order_relaxed);
+  }
+  idleHelpers_.fetch_sub(1, std::memory_order_relaxed);
+}
 
-  using namespace std::chrono;
-  auto start = high_resolution_clock::now();
-  int timeLimitMs = 500; // ограничение времени на поиск
+int Engine::minimax(Position &pos, int depth, bool isMaximizing, int alpha,
+                    int beta, int remainingBlackMoves,
+                    int remainingWhiteMoves) {
+  // отдельный вызов без ограничения по времени, в главном потоке; фоновое
+  // размышление делит с ним сроки, флаг остановки и потоки, поэтому
+  // сначала останавливается
+  stopPondering();
+  hardDeadline_.store(kNoDeadline, std::memory_order_relaxed);
+  stop_.store(false, std::memory_order_relaxed);
+  SearchWorker &w = *workers_[0];
+  // оценка негамакса — с точки зрения стороны на ходу, у белых знак обратный
+  if (isMaximizing)
+    return search(w, pos, depth, 0, 'B', alpha, beta, remainingBlackMoves,
+                  remainingWhiteMoves);
+  return -search(w, pos, depth, 0, 'W', -beta, -alpha, remainingBlackMoves,
+                 remainingWhiteMoves);
+}
+
+int Engine::search(SearchWorker &w, Position &pos, int depth, int ply,
+                   char player, int alpha, int beta, int remainingBlackMoves,
+                   int remainingWhiteMoves) {
+  UGOLKI_PROFILE_SCOPE(Search);
+  w.pvLength[ply] = ply;
+  if (ply > w.stats.selDepth)
+    w.stats.selDepth = ply;
+  if ((++w.stats.nodes & kTimeCheckMask) == 0 &&
+      ticksNow() >= hardDeadline_.load(std::memory_order_relaxed)) {
+    stop_.store(true, std::memory_order_relaxed);
+    UGOLKI_TRACE_INSTANT(Deadline, w.stats.nodes);
+  }
+  if (shouldStop(w))
+    return 0;
+
+  // Позиция из таблиц эндшпиля: точный итог вместо перебора и оценки.
+  // Проверяется до конца партии по checkWin, ведь в таблицах почти все
+  // фишки уже в углах
+  TablebaseResult tbResult;
+  if (ply > 0 && tablebase_ &&
+      tablebase_->probe(pos, player, remainingBlackMoves, remainingWhiteMoves,
+                        tbResult)) {
+    ++w.stats.tablebaseHits;
+    return tablebaseScore(tbResult);
+  }
+
+  const int sign = player == 'B' ? 1 : -1;
+  // Кончились ходы у стороны, которая должна ходить: партия окончена.
+  // В корне ищем всегда, иначе не из чего выбрать ход
+  int remaining = player == 'B' ? remainingBlackMoves : remainingWhiteMoves;
+  if (depth == 0 || ply >= max_search_depth - 1 ||
+      (ply > 0 &&
+       (remaining <= 0 || checkWin(pos, 'B') || checkWin(pos, 'W')))) {
+    ++w.stats.leafEvals;
+    return sign * evaluateBoard(pos, remainingBlackMoves, remainingWhiteMoves);
+  }
 
-  int bestValue = -1000000;
+  // Узел главного варианта ищется с открытым окном, остальные — с нулевым
+  const bool pvNode = beta - alpha > 1;
+  const uint64_t key = positionKey(pos, player, remainingBlackMoves,
+                                   remainingWhiteMoves);
+  uint16_t ttMove = 0;
+  TTHit hit;
+  ++w.stats.ttProbes;
+  if (tt_.probe(key, hit)) {
+    ++w.stats.ttHits;
+    ttMove = hit.move;
+    // в узлах главного варианта не отсекаем, чтобы не обрывать вариант
+    if (!pvNode && hit.depth >= depth &&
+        (hit.bound == Bound::Exact ||
+         (hit.bound == Bound::Lower && hit.score >= beta) ||
+         (hit.bound == Bound::Upper && hit.score <= alpha))) {
+      ++w.stats.ttCutoffs;
+      return hit.score;
+    }
+  }
+  const int alphaOrig = alpha;
+
+  MoveList moves;
+  generateMoves(pos, player, moves);
+  if (moves.empty()) {
+    ++w.stats.leafEvals;
+    return sign * evaluateBoard(pos, remainingBlackMoves, remainingWhiteMoves);
+  }
+
+  int scores[max_moves];
+  scoreMoves(w, moves, player, Move(ttMove), ply, scores);
+
+  const char opponent = player == 'B' ? 'W' : 'B';
+  const int childBlack = remainingBlackMoves - (player == 'B' ? 1 : 0);
+  const int childWhite = remainingWhiteMoves - (player == 'W' ? 1 : 0);
+  int bestScore = -kInfinity;
   Move bestMove = moves[0];
+  for (int i = 0; i < moves.size(); ++i) {
+    // Младшие братья ждут, пока старший перебран; затем узел публикуется
+    // как точка разделения и ходы разбираются вместе со свободными потоками
+    if (i == 1 && canSplit(w, depth)) {
+      SplitPoint sp;
+      sp.parent = w.activeSplit;
+      sp.pos = pos;
+      sp.moves = &moves;
+      sp.scores = scores;
+      sp.player = player;
+      sp.depth = depth;
+      sp.ply = ply;
+      sp.remainingBlackMoves = remainingBlackMoves;
+      sp.remainingWhiteMoves = remainingWhiteMoves;
+      sp.beta = beta;
+      sp.pvNode = pvNode;
+      sp.next = 1;
+      sp.alpha = alpha;
+      sp.bestScore = bestScore;
+      sp.bestMove = bestMove;
+      {
+        std::lock_guard<std::mutex> guard(w.splitMutex);
+        w.splits[w.splitCount++] = &sp;
+      }
+      searchSplitPoint(w, sp);
+      {
+        std::lock_guard<std::mutex> guard(w.splitMutex);
+        --w.splitCount;
+      }
+      // после снятия с публикации новые помощники не придут, ждём старых
+      while (sp.helpers.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
+      if (shouldStop(w))
+        return 0;
+
+      bestScore = sp.bestScore;
+      bestMove = sp.bestMove;
+      alpha = sp.alpha;
+      if (sp.pvLength > 0) {
+        for (int k = 0; k < sp.pvLength; ++k)
+          w.pv[ply][ply + k] = sp.pv[k];
+        w.pvLength[ply] = ply + sp.pvLength;
+      }
+      break;
+    }
+
+    pickNextMove(moves, scores, i);
+    Move m = moves[i];
+    if (ply == 0)
+      UGOLKI_TRACE_BEGIN(RootMove, m.data);
+    Undo undo;
+    makeMove(pos, m, player, undo);
+    int score;
+    if (i == 0) {
+      score = -search(w, pos, depth - 1, ply + 1, opponent, -beta, -alpha,
+                      childBlack, childWhite);
+    } else {
+      // PVS: остальные ходы только проверяются нулевым окном,
+      // полный перебор — лишь если ход оказался лучше
+      score = -search(w, pos, depth - 1, ply + 1, opponent, -alpha - 1,
+                      -alpha, childBlack, childWhite);
+      if (score > alpha && score < beta)
+        score = -search(w, pos, depth - 1, ply + 1, opponent, -beta, -alpha,
+                        childBlack, childWhite);
+    }
+    unmakeMove(pos, undo, player);
+    if (ply == 0)
+      UGOLKI_TRACE_END(RootMove, m.data);
+    if (shouldStop(w))
+      return 0;
+
+    if (score > bestScore) {
+      bestScore = score;
+      bestMove = m;
+      if (score > alpha) {
+        alpha = score;
+        // вариант узла: этот ход и вариант потомка
+        w.pv[ply][ply] = m;
+        for (int k = ply + 1; k < w.pvLength[ply + 1]; ++k)
+          w.pv[ply][k] = w.pv[ply + 1][k];
+        w.pvLength[ply] = std::max(ply + 1, w.pvLength[ply + 1]);
+      }
+    }
+    if (alpha >= beta) {
+      ++w.stats.cutoffs;
+      if (i == 0)
+        ++w.stats.firstMoveCutoffs;
+      int gain;
+      if (!isForwardJump(m, player, gain))
+        updateQuietCutoff(w, m, player, depth, ply);
+      break;
+    }
+  }
 
-  for (auto &m : moves) {
-    auto backupBoard = board;
-    auto backupCorner = inOpponentCorner;
+  Bound bound = bestScore <= alphaOrig ? Bound::Upper
+                : bestScore >= beta    ? Bound::Lower
+                                       : Bound::Exact;
+  tt_.store(key, depth, bound, bestScore, bestMove.data);
+  return bestScore;
+}
 
-    makeMove(m.x1, m.y1, m.x2, m.y2, 'B');
+int Engine::solve(SearchWorker &w, Position &pos, int ply, char player,
+                  int alpha, int beta, int remainingBlackMoves,
+                  int remainingWhiteMoves) {
+  if (++w.stats.nodes >= limits_.solverNodes ||
+      ((w.stats.nodes & kTimeCheckMask) == 0 &&
+       ticksNow() >= softDeadline_.load(std::memory_order_relaxed)))
+    solveAborted_ = true;
+  if (solveAborted_ || stop_.load(std::memory_order_relaxed)) {
+    solveAborted_ = true;
+    return 0;
+  }
 
-    int moveValue =
-        minimax(2, false, -1000000, 1000000, blackMoves - 1, whiteMoves);
+  // Границы итога часто отсекают узел без перебора
+  const char opponent = player == 'B' ? 'W' : 'B';
+  const int remaining =
+      player == 'B' ? remainingBlackMoves : remainingWhiteMoves;
+  int lower, upper;
+  marginBounds(pos, player, remainingBlackMoves, remainingWhiteMoves, lower,
+               upper);
+  if (upper <= alpha || lower == upper)
+    return upper;
+  if (lower >= beta)
+    return lower;
+  // ходы кончились только у этой стороны: ходит соперник
+  if (remaining == 0)
+    return -solve(w, pos, ply + 1, opponent, -beta, -alpha,
+                  remainingBlackMoves, remainingWhiteMoves);
 
-    board = backupBoard;
-    inOpponentCorner = backupCorner;
+  const uint64_t key = positionKey(pos, player, remainingBlackMoves,
+                                   remainingWhiteMoves) ^
+                       kSolverKey;
+  uint16_t ttMove = 0;
+  TTHit hit;
+  if (tt_.probe(key, hit)) {
+    ttMove = hit.move;
+    if (hit.bound == Bound::Exact ||
+        (hit.bound == Bound::Lower && hit.score >= beta) ||
+        (hit.bound == Bound::Upper && hit.score <= alpha))
+      return hit.score;
+  }
+
+  const int childBlack = remainingBlackMoves - (player == 'B' ? 1 : 0);
+  const int childWhite = remainingWhiteMoves - (player == 'W' ? 1 : 0);
+  MoveList moves;
+  generateMoves(pos, player, moves);
+  // без ходов сторона пропускает ход, но ход у неё сгорает
+  if (moves.empty())
+    return -solve(w, pos, ply + 1, opponent, -beta, -alpha, childBlack,
+                  childWhite);
 
-    if (moveValue > bestValue) {
-      bestValue = moveValue;
+  int scores[max_moves];
+  scoreMoves(w, moves, player, Move(ttMove), ply, scores);
+  const int alphaOrig = alpha;
+  const int horizon = remainingBlackMoves + remainingWhiteMoves;
+  int bestScore = -kInfinity;
+  Move bestMove = moves[0];
+  for (int i = 0; i < moves.size(); ++i) {
+    pickNextMove(moves, scores, i);
+    Move m = moves[i];
+    Undo undo;
+    makeMove(pos, m, player, undo);
+    int score = -solve(w, pos, ply + 1, opponent, -beta, -alpha, childBlack,
+                       childWhite);
+    unmakeMove(pos, undo, player);
+    if (solveAborted_)
+      return 0;
+
+    if (score > bestScore) {
+      bestScore = score;
       bestMove = m;
+      alpha = std::max(alpha, score);
+    }
+    if (alpha >= beta) {
+      ++w.stats.cutoffs;
+      if (i == 0)
+        ++w.stats.firstMoveCutoffs;
+      int gain;
+      if (!isForwardJump(m, player, gain))
+        updateQuietCutoff(w, m, player, horizon, ply);
+      break;
+    }
+  }
+
+  Bound bound = bestScore <= alphaOrig ? Bound::Upper
+                : bestScore >= beta    ? Bound::Lower
+                                       : Bound::Exact;
+  tt_.store(key, horizon, bound, bestScore, bestMove.data);
+  return bestScore;
+}
+
+bool Engine::solvePosition(SearchWorker &w, const GameState &game,
+                           char player, Move &bestMove) {
+  const int horizon = game.blackMoves + game.whiteMoves;
+  if (limits_.solverNodes == 0 || horizon > kSolverMaxPlies)
+    return false;
+  UGOLKI_TRACE_SCOPE(Solve, horizon);
+  solveAborted_ = false;
+  Position pos = game.board;
+  MoveList moves = generateMoves(pos, player);
+  const char opponent = player == 'B' ? 'W' : 'B';
+  const int childBlack = game.blackMoves - (player == 'B' ? 1 : 0);
+  const int childWhite = game.whiteMoves - (player == 'W' ? 1 : 0);
+
+  // MTD(f): итог сужается поисками с нулевым окном вокруг догадки. Первая
+  // догадка — итог прошлого перебора этой позиции или нынешний счёт
+  const uint64_t key =
+      positionKey(pos, player, game.blackMoves, game.whiteMoves) ^ kSolverKey;
+  TTHit hit;
+  int guess = tt_.probe(key, hit) ? hit.score
+                                  : piecesHome(pos, player) -
+                                        piecesHome(pos, opponent);
+  int lower = -pieces_per_side, upper = pieces_per_side;
+  Move best = moves[0];
+  while (lower < upper) {
+    const int beta = guess == lower ? guess + 1 : guess;
+    // лучший ход прошлых поисков проверяется первым
+    std::swap(*std::find(moves.begin(), moves.end(), best), moves[0]);
+    int value = -kInfinity;
+    for (Move m : moves) {
+      Undo undo;
+      makeMove(pos, m, player, undo);
+      int score = -solve(w, pos, 1, opponent, -beta, -beta + 1, childBlack,
+                         childWhite);
+      unmakeMove(pos, undo, player);
+      if (solveAborted_)
+        return false;
+      value = std::max(value, score);
+      if (score >= beta) {
+        best = m;
+        break;
+      }
+    }
+    if (value >= beta)
+      lower = value;
+    else
+      upper = value;
+    guess = value;
+  }
+  tt_.store(key, horizon, Bound::Exact, lower, best.data);
+
+  // Вариант — лучшие ходы из записей перебора до конца партии
+  rootPv_.assign(1, best);
+  GameState line = game;
+  char side = player;
+  for (Move m = best; rootPv_.size() < size_t(horizon);) {
+    makeMove(line.board, m.x1(), m.y1(), m.x2(), m.y2(), side);
+    (side == 'B' ? line.blackMoves : line.whiteMoves)--;
+    side = side == 'B' ? 'W' : 'B';
+    if (!tt_.probe(positionKey(line.board, side, line.blackMoves,
+                               line.whiteMoves) ^
+                       kSolverKey,
+                   hit) ||
+        hit.move == 0)
+      break;
+    m = Move(hit.move);
+    if (!isValidMove(line.board, m.x1(), m.y1(), m.x2(), m.y2(), side))
+      break;
+    rootPv_.push_back(m);
+  }
+
+  bestMove = best;
+  completedDepth_ = horizon;
+  completedScore_ = solvedScore(player == 'B' ? lower : -lower);
+  return true;
+}
+
+bool Engine::provePosition(SearchWorker &w, const GameState &game,
+                           char player, Move &bestMove) {
+  const int horizon = game.blackMoves + game.whiteMoves;
+  if (limits_.proofNodes == 0 || horizon > kProofMaxPlies)
+    return false;
+  UGOLKI_TRACE_SCOPE(Prove, horizon);
+  // На доказательство уходит не больше половины мягкого срока: если оно
+  // не удалось, обычному поиску остаётся время
+  const int64_t deadline =
+      std::min(softDeadline_.load(std::memory_order_relaxed),
+               ticksAfter(limits_.softTimeMs / 2));
+  Move move;
+  const ProofResult result = pns_->prove(
+      game, player, player, ProofGoal::Margin, 1, limits_.proofNodes, move,
+      [this, deadline] {
+        return stop_.load(std::memory_order_relaxed) || ticksNow() >= deadline;
+      });
+  w.stats.proofNodes += pns_->nodes();
+  w.stats.nodes += pns_->nodes();
+  if (result != ProofResult::Proven || move == Move())
+    return false;
+
+  bestMove = move;
+  rootPv_.assign(1, move);
+  completedDepth_ = horizon;
+  completedScore_ = solvedScore(player == 'B' ? 1 : -1);
+  return true;
+}
+
+void Engine::iterate(SearchWorker &w, const GameState &game, char player,
+                     int maxDepth) {
+  Position pos = game.board;
+  // Помощники Lazy SMP с нечётным номером идут на полуход впереди
+  // главного потока, поэтому потоки реже перебирают одно и то же
+  const int depthOffset = w.id & 1;
+  int score = 0;
+  for (int depth = 1 + depthOffset; depth <= maxDepth; ++depth) {
+    // Окно аспирации вокруг оценки прошлой итерации; при выходе за окно
+    // оно расширяется в сторону провала, пока оценка не попадёт внутрь
+    UGOLKI_TRACE_SCOPE(Iteration, depth);
+    int delta = kAspirationWindow;
+    int alpha = -kInfinity, beta = kInfinity;
+    if (depth >= kAspirationMinDepth) {
+      alpha = std::max(score - delta, -kInfinity);
+      beta = std::min(score + delta, kInfinity);
+    }
+    for (;;) {
+      int value = search(w, pos, depth, 0, player, alpha, beta,
+                         game.blackMoves, game.whiteMoves);
+      if (stop_.load(std::memory_order_relaxed))
+        break;
+      if (value <= alpha && alpha > -kInfinity) {
+        alpha = std::max(value - delta, -kInfinity);
+      } else if (value >= beta && beta < kInfinity) {
+        beta = std::min(value + delta, kInfinity);
+      } else {
+        score = value;
+        break;
+      }
+      delta *= 2;
+    }
+    // Незавершённая итерация отбрасывается целиком
+    if (stop_.load(std::memory_order_relaxed)) {
+      UGOLKI_TRACE_INSTANT(Abort, depth);
+      break;
+    }
+    w.completedDepth = depth;
+    w.completedScore = score;
+    w.rootPvLength = w.pvLength[0];
+    for (int k = 0; k < w.rootPvLength; ++k)
+      w.rootPv[k] = w.pv[0][k];
+    if (w.id == 0 && w.stats.iterations < max_search_depth) {
+      w.stats.iterationMs[w.stats.iterations] =
+          millisecondsSince(searchStart_);
+      w.stats.iterationNodes[w.stats.iterations] = w.stats.nodes;
+      ++w.stats.iterations;
+    }
+
+    if (w.id == 0 &&
+        ticksNow() >= softDeadline_.load(std::memory_order_relaxed))
+      break;
+  }
+}
+
+const SearchWorker &Engine::pickResult() const {
+  const SearchWorker *best = workers_[0].get();
+  int deepest = 0, minScore = kInfinity;
+  for (const auto &w : workers_)
+    if (w->completedDepth > 0 && w->rootPvLength > 0) {
+      deepest = std::max(deepest, w->completedDepth);
+      minScore = std::min(minScore, w->completedScore);
+    }
+  // Главный поток решает сам, пока помощники не ушли глубже него
+  if (deepest <= best->completedDepth)
+    return *best;
+
+  // Голосование: вес потока растёт с глубиной и оценкой его итерации,
+  // побеждает ход с наибольшей суммой; при равенстве — более глубокий поток
+  auto votesFor = [&](Move m) {
+    long long votes = 0;
+    for (const auto &w : workers_)
+      if (w->completedDepth > 0 && w->rootPvLength > 0 && w->rootPv[0] == m)
+        votes += (long long)(w->completedScore - minScore + 1) *
+                 w->completedDepth;
+    return votes;
+  };
+  long long bestVotes = best->rootPvLength > 0 ? votesFor(best->rootPv[0]) : 0;
+  for (const auto &w : workers_) {
+    if (w->completedDepth == 0 || w->rootPvLength == 0)
+      continue;
+    long long votes = votesFor(w->rootPv[0]);
+    if (votes > bestVotes ||
+        (votes == bestVotes && w->completedDepth > best->completedDepth)) {
+      best = w.get();
+      bestVotes = votes;
+    }
+  }
+  return *best;
+}
+
+Engine::~Engine() { stopPondering(); }
+
+bool Engine::findBestMove(const GameState &game, char player, Move &bestMove) {
+  if (ponderThread_.joinable()) {
+    if (player == ponderPlayer_ &&
+        game.board.white == ponderGame_.board.white &&
+        game.board.black == ponderGame_.board.black &&
+        game.blackMoves == ponderGame_.blackMoves &&
+        game.whiteMoves == ponderGame_.whiteMoves) {
+      // Попадание: поиск уже идёт по этой позиции, теперь ему даются
+      // обычные сроки хода, отсчитанные от текущего момента
+      softDeadline_.store(ticksAfter(limits_.softTimeMs),
+                          std::memory_order_relaxed);
+      hardDeadline_.store(ticksAfter(limits_.hardTimeMs),
+                          std::memory_order_relaxed);
+      ponderThread_.join();
+      ++ponderHits_;
+      bestMove = ponderBest_;
+      return ponderFound_;
     }
+    stopPondering();
+  }
+  softDeadline_.store(ticksAfter(limits_.softTimeMs),
+                      std::memory_order_relaxed);
+  hardDeadline_.store(ticksAfter(limits_.hardTimeMs),
+                      std::memory_order_relaxed);
+  stop_.store(false, std::memory_order_relaxed);
+  return searchPosition(game, player, bestMove);
+}
+
+bool Engine::startPondering(const GameState &game, char player) {
+  stopPondering();
+  // Ожидаемый ответ — второй ход главного варианта: первый ИИ уже сделал
+  int movesLeft = player == 'B' ? game.blackMoves : game.whiteMoves;
+  if (rootPv_.size() < 2 || movesLeft <= 0)
+    return false;
+  Move predicted = rootPv_[1];
+  if (!isValidMove(game.board, predicted.x1(), predicted.y1(), predicted.x2(),
+                   predicted.y2(), player))
+    return false;
+
+  ponderGame_ = game;
+  ponderGame_.moveHistory.clear();
+  makeMove(ponderGame_.board, predicted.x1(), predicted.y1(), predicted.x2(),
+           predicted.y2(), player);
+  if (player == 'B')
+    ponderGame_.blackMoves--;
+  else
+    ponderGame_.whiteMoves--;
+  ponderPlayer_ = player == 'B' ? 'W' : 'B';
+  ponderMove_ = predicted;
+
+  // Без сроков: поиск идёт, пока соперник думает
+  softDeadline_.store(kNoDeadline, std::memory_order_relaxed);
+  hardDeadline_.store(kNoDeadline, std::memory_order_relaxed);
+  stop_.store(false, std::memory_order_relaxed);
+  ponderThread_ = std::thread([this] {
+    ponderFound_ = searchPosition(ponderGame_, ponderPlayer_, ponderBest_);
+  });
+  return true;
+}
+
+void Engine::stopPondering() {
+  if (!ponderThread_.joinable())
+    return;
+  // флаг остановки проверяется в каждом узле, поиск выходит сразу
+  stop_.store(true, std::memory_order_relaxed);
+  ponderThread_.join();
+}
+
+bool Engine::searchPosition(const GameState &game, char player,
+                            Move &bestMove) {
+  UGOLKI_TRACE_SCOPE(Search, player);
+  searchStart_ = ticksNow();
+  // счётчики вызывающего потока; помощники открывают свои
+  PerfCounterGroup counters;
+  if (hardwareCounters_)
+    counters.start();
+  MoveList rootMoves = generateMoves(game.board, player);
+  if (rootMoves.empty())
+    return false;
+  bestMove = rootMoves[0];
+  solved_ = false;
+  completedDepth_ = 0;
+  completedScore_ = 0;
+  rootPv_.assign(1, bestMove);
+  stats_ = SearchStats();
+  if (rootMoves.size() == 1)
+    return true;
+
+  tt_.newSearch();
+  for (auto &w : workers_) {
+    w->stats = SearchStats();
+    w->completedDepth = w->completedScore = w->rootPvLength = 0;
+    // убийцы прошлого поиска устарели, история лишь ослабляется
+    for (auto &slots : w->killers)
+      for (Move &m : slots)
+        m = Move();
+    for (auto &colour : w->history)
+      for (auto &row : colour)
+        for (int &value : row)
+          value /= 2;
+  }
+
+  // глубже конца партии искать бессмысленно
+  const int maxDepth = std::min(
+      limits_.maxDepth, std::max(1, game.blackMoves + game.whiteMoves));
+
+  // Близко к концу партии ход находится точным перебором, если он
+  // укладывается в бюджет; иначе — доказательством выигрыша или обычным
+  // поиском
+  solved_ = solvePosition(*workers_[0], game, player, bestMove);
+  if (!solved_)
+    solved_ = provePosition(*workers_[0], game, player, bestMove);
 
-    // Проверяем время
-    auto now = high_resolution_clock::now();
-    if (duration_cast<milliseconds>(now - start).count() > timeLimitMs) {
-      break; // выходим, чтобы не зависнуть
+  // Lazy SMP: помощники ищут тот же корень через общую таблицу
+  // транспозиций. YBWC: помощники ждут точек разделения главного потока.
+  // В обоих режимах они останавливаются, когда главный поток закончил
+  std::vector<std::thread> helpers;
+  for (size_t i = 1; i < workers_.size() && !solved_; ++i)
+    helpers.emplace_back([this, i, &game, player, maxDepth] {
+      UGOLKI_TRACE_SCOPE(Helper, i);
+      PerfCounterGroup helperCounters;
+      if (hardwareCounters_)
+        helperCounters.start();
+      if (mode_ == ParallelMode::Ybwc)
+        helperLoop(*workers_[i]);
+      else
+        iterate(*workers_[i], game, player, maxDepth);
+      helperCounters.stop(workers_[i]->stats.hardware);
+    });
+  if (!solved_)
+    iterate(*workers_[0], game, player, maxDepth);
+  stop_.store(true, std::memory_order_relaxed);
+  for (auto &t : helpers)
+    t.join();
+
+  // Итерации — главного потока, счётчики — сумма по всем потокам
+  stats_ = workers_[0]->stats;
+  for (size_t i = 1; i < workers_.size(); ++i)
+    stats_.merge(workers_[i]->stats);
+  if (!solved_) {
+    const SearchWorker &result = pickResult();
+    if (result.completedDepth > 0 && result.rootPvLength > 0) {
+      completedDepth_ = result.completedDepth;
+      completedScore_ =
+          player == 'B' ? result.completedScore : -result.completedScore;
+      rootPv_.assign(result.rootPv, result.rootPv + result.rootPvLength);
+      bestMove = rootPv_[0];
     }
   }
+  counters.stop(stats_.hardware);
+  stats_.depth = completedDepth_;
+  // точный перебор и доказательство доходят до конца партии
+  stats_.selDepth = std::max(stats_.selDepth, stats_.depth);
+  stats_.timeMs = millisecondsSince(searchStart_);
+  return true;
+}
+
+bool Engine::probeBook(const GameState &game, char player, Move &move) {
+  if (!book_)
+    return false;
+  const uint64_t key =
+      positionKey(game.board, player, game.blackMoves, game.whiteMoves);
+  const BookEntry *first, *last;
+  book_->find(key, first, last);
+  if (!book_->pick(first, last, rng_(), move) ||
+      !isValidMove(game.board, move.x1(), move.y1(), move.x2(), move.y2(),
+                   player))
+    return false;
+
+  // Размышление шло над другой позицией; результат хода — запись книги
+  stopPondering();
+  stats_ = SearchStats();
+  solved_ = false;
+  completedDepth_ = 0;
+  completedScore_ = 0;
+  for (const BookEntry *e = first; e != last; ++e)
+    if (e->move == move.data)
+      completedScore_ = player == 'B' ? e->score : -e->score;
+  rootPv_.assign(1, move);
+  return true;
+}
+
+void SearchEngine::playMove(GameState &game, Move move, char player) {
+  makeMove(game.board, move.x1(), move.y1(), move.x2(), move.y2(), player);
+  if (player == 'B')
+    game.blackMoves--;
+  else
+    game.whiteMoves--;
+
+  game.moveNumber++;
+  game.moveHistory.push_back(std::to_string(game.moveNumber) +
+                             ". AI: " + moveToString(move));
+}
+
+bool passTurn(GameState &game, char player) {
+  int &remaining = player == 'B' ? game.blackMoves : game.whiteMoves;
+  if (remaining <= 0 || !generateMoves(game.board, player).empty())
+    return false;
+  --remaining;
+  game.moveNumber++;
+  return true;
+}
+
+bool SearchEngine::makeAIMove(GameState &game, char player) {
+  Move bestMove;
+  if (!findBestMove(game, player, bestMove))
+    return false;
+  playMove(game, bestMove, player);
+  return true;
+}
+
+bool Engine::makeAIMove(GameState &game, char player) {
+  UGOLKI_TRACE_SCOPE(MakeAIMove, player);
+  Move bestMove;
+  if (!probeBook(game, player, bestMove) &&
+      !findBestMove(game, player, bestMove))
+    return false;
 
   // Выполняем лучший найденный ход
-  makeMove(bestMove.x1, bestMove.y1, bestMove.x2, bestMove.y2, 'B');
-  blackMoves--;
+  playMove(game, bestMove, player);
+  return true;
+}
+
+std::string moveToString(Move m) {
+  return std::string(1, char('A' + m.y1())) + std::to_string(m.x1() + 1) +
+         " -> " + std::string(1, char('A' + m.y2())) +
+         std::to_string(m.x2() + 1);
+}
+
+std::string variationToString(const std::vector<Move> &line) {
+  std::string text;
+  for (Move m : line) {
+    if (!text.empty())
+      text += ", ";
+    text += moveToString(m);
+  }
+  return text;
+}
+
+Position startPosition() {
+  Position pos;
+  for (int i = 0; i < corner_size; ++i)
+    for (int j = 0; j < corner_size - i; ++j) {
+      pos.set(i, j, 'W');
+      pos.set(board_size - 1 - i, board_size - 1 - j, 'B');
+    }
+  return pos;
+}
 
-  char colFrom = 'A' + bestMove.y1, colTo = 'A' + bestMove.y2;
-  int rowFrom = bestMove.x1 + 1, rowTo = bestMove.x2 + 1;
-  moveNumber++;
-  moveHistory.push_back(std::to_string(moveNumber) + ". AI: " +
-                        std::string(1, colFrom) + std::to_string(rowFrom) +
-                        " -> " + std::string(1, colTo) + std::to_string(rowTo));
+std::string positionToString(const GameState &game, char sideToMove) {
+  std::string text;
+  for (int x = board_size - 1; x >= 0; --x) {
+    for (int y = 0; y < board_size; ++y)
+      text += game.board.at(x, y);
+    text += x > 0 ? '/' : ' ';
+  }
+  text += sideToMove;
+  text += ' ' + std::to_string(game.whiteMoves) + ' ' +
+          std::to_string(game.blackMoves);
+  return text;
+}
 
+bool parsePosition(const std::string &text, GameState &game, char &sideToMove) {
+  std::istringstream in(text);
+  std::string rows;
+  int whiteMoves = 0, blackMoves = 0;
+  if (!(in >> rows >> sideToMove >> whiteMoves >> blackMoves))
+    return false;
+  if ((sideToMove != 'W' && sideToMove != 'B') ||
+      rows.size() != size_t(board_size * (board_size + 1) - 1))
+    return false;
+
+  GameState parsed;
+  for (int x = board_size - 1, i = 0; x >= 0; --x, ++i) {
+    for (int y = 0; y < board_size; ++y) {
+      char c = rows[i * (board_size + 1) + y];
+      if (c != 'W' && c != 'B' && c != '.')
+        return false;
+      parsed.board.set(x, y, c);
+    }
+    if (x > 0 && rows[i * (board_size + 1) + board_size] != '/')
+      return false;
+  }
+  parsed.whiteMoves = whiteMoves;
+  parsed.blackMoves = blackMoves;
+  game = parsed;
+  return true;
+}
+
+bool loadCorpus(const std::string &path, std::vector<CorpusEntry> &entries) {
+  std::ifstream in(path);
+  if (!in) {
+    std::fprintf(stderr, "cannot open %s\n", path.c_str());
+    return false;
+  }
+  std::string line, section = "positions";
+  while (std::getline(in, line)) {
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    if (line.empty())
+      continue;
+    if (line[0] == '#') {
+      const size_t start = line.find_first_not_of("# ");
+      if (start != std::string::npos && line.size() - start <= 16)
+        section = line.substr(start);
+      continue;
+    }
+    CorpusEntry entry;
+    if (!parsePosition(line, entry.game, entry.side)) {
+      std::fprintf(stderr, "bad position: %s\n", line.c_str());
+      return false;
+    }
+    entry.section = section;
+    entries.push_back(entry);
+  }
   return true;
 }
@@ -1,32 +1,486 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "perf_counters.h"
+#include "tt.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Размеры доски и угла (треугольника из 10 клеток)
+constexpr int board_size = 8;
+constexpr int corner_size = 4;
+static_assert(board_size * board_size == 64, "битборды рассчитаны на доску 8x8");
+// Предельная глубина перебора (в полуходах)
+constexpr int max_search_depth = 64;
+
+// Клетка board[x][y] хранится в бите x * board_size + y
+constexpr int square(int x, int y) { return x * board_size + y; }
+inline uint64_t squareBit(int x, int y) { return 1ULL << square(x, y); }
+
+// Ход в 16 битах: клетка from в младших 6 битах, клетка to — в следующих 6.
+// Тот же вид хранится в таблице транспозиций; 0 означает «хода нет»
 struct Move {
-  int x1, y1, x2, y2;
+  uint16_t data = 0;
+
+  Move() = default;
+  constexpr explicit Move(uint16_t packed) : data(packed) {}
+  constexpr Move(int from, int to) : data(uint16_t(from | to << 6)) {}
+  constexpr Move(int x1, int y1, int x2, int y2)
+      : Move(square(x1, y1), square(x2, y2)) {}
+
+  int from() const { return data & 63; }
+  int to() const { return (data >> 6) & 63; }
+  int x1() const { return from() / board_size; }
+  int y1() const { return from() % board_size; }
+  int x2() const { return to() / board_size; }
+  int y2() const { return to() % board_size; }
 };
 
-// Основные функции AI
-bool makeAIMove();
-std::vector<Move> generateMoves(char player);
-int minimax(int depth, bool isMaximizing, int alpha, int beta,
-            int remainingBlackMoves, int remainingWhiteMoves);
-int evaluateBoard(const std::vector<std::vector<char>> &boardState,
-                  int remainingBlackMoves, int remainingWhiteMoves);
-int distanceToCorner(int x, int y, char player);
+static_assert(sizeof(Move) == 2, "ход должен занимать 16 бит");
+
+inline bool operator==(Move a, Move b) { return a.data == b.data; }
+inline bool operator!=(Move a, Move b) { return a.data != b.data; }
+
+// Фишек у каждой стороны — клеток в угловом треугольнике
+constexpr int pieces_per_side = corner_size * (corner_size + 1) / 2;
+// Оценка сверху числа ходов: у фишки не больше 4 шагов, а прыжок сохраняет
+// цвет клетки, поэтому целей прыжков не больше половины доски без исходной
+constexpr int max_moves =
+    pieces_per_side * (4 + board_size * board_size / 2 - 1);
+
+// Список ходов фиксированной ёмкости: живёт на стеке, кучу не трогает
+class MoveList {
+public:
+  void clear() { size_ = 0; }
+  void push_back(Move m) { moves_[size_++] = m; }
+  int size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  Move &operator[](int i) { return moves_[i]; }
+  Move operator[](int i) const { return moves_[i]; }
+  Move *begin() { return moves_; }
+  Move *end() { return moves_ + size_; }
+  const Move *begin() const { return moves_; }
+  const Move *end() const { return moves_ + size_; }
+
+private:
+  Move moves_[max_moves];
+  int size_ = 0;
+};
+
+// Число установленных битов и индекс младшего бита (b != 0)
+inline int popCount(uint64_t b) {
+#if defined(_MSC_VER)
+  return static_cast<int>(__popcnt64(b));
+#else
+  return __builtin_popcountll(b);
+#endif
+}
+
+inline int lsb(uint64_t b) {
+#if defined(_MSC_VER)
+  unsigned long idx;
+  _BitScanForward64(&idx, b);
+  return static_cast<int>(idx);
+#else
+  return __builtin_ctzll(b);
+#endif
+}
+
+// Индекс стороны в таблицах: 0 — белые, 1 — чёрные
+inline int colourIndex(char player) { return player == 'W' ? 0 : 1; }
+
+// Позиция на битбордах: белые, чёрные и фишки, запертые в чужом углу.
+// key (ключ Зобриста), score (сумма по таблицам «фишка-клетка») и home
+// (число фишек стороны в её целевом углу) обновляются при каждом ходе
+struct Position {
+  uint64_t white = 0;
+  uint64_t black = 0;
+  uint64_t locked = 0;
+  uint64_t key = 0;
+  int score = 0;
+  uint8_t home[2] = {0, 0};
+
+  char at(int x, int y) const;
+  // Фишка, поставленная в свой целевой угол, сразу запирается
+  void set(int x, int y, char piece);
+  void clear() {
+    white = black = locked = key = 0;
+    score = 0;
+    home[0] = home[1] = 0;
+  }
+  uint64_t pieces(char player) const { return player == 'W' ? white : black; }
+  uint64_t occupied() const { return white | black; }
+};
+
+// Запись для отката хода: клетки хода и флаг запирания фишки в углу
+struct Undo {
+  uint8_t from, to;
+  bool locked;
+};
+
+// Состояние партии: позиция, оставшиеся ходы сторон и история ходов
+struct GameState {
+  Position board;
+  int blackMoves = 20;
+  int whiteMoves = 20;
+  std::vector<std::string> moveHistory;
+  size_t moveNumber = 0;
+};
+
+// Текстовая запись позиции для тестов и бенчмарков: ряды доски от x = 7
+// до x = 0 через '/', сторона на ходу, оставшиеся ходы белых и чёрных:
+// "....BBBB/.....BBB/......BB/.......B/W......./WW....../WWW...../WWWW.... W 20 20"
+std::string positionToString(const GameState &game, char sideToMove);
+// Ход в записи истории ("A1 -> B2") и вариант из таких ходов через запятую
+std::string moveToString(Move m);
+std::string variationToString(const std::vector<Move> &line);
+bool parsePosition(const std::string &text, GameState &game, char &sideToMove);
+// Набор позиций бенчмарков и тестов: по позиции на строку, пустые строки и
+// комментарии '#' пропускаются; короткий комментарий (до 16 символов) даёт
+// имя разделу следующих позиций, по умолчанию "positions". Ошибки открытия
+// и разбора печатаются в stderr
+struct CorpusEntry {
+  GameState game;
+  char side;
+  std::string section;
+};
+bool loadCorpus(const std::string &path, std::vector<CorpusEntry> &entries);
+
+// Правила и оценка: работают только с переданной позицией
+// Начальная расстановка: белые в углу (0, 0), чёрные в противоположном
+Position startPosition();
+MoveList generateMoves(const Position &pos, char player);
+void generateMoves(const Position &pos, char player, MoveList &moves);
+int evaluateBoard(const Position &pos, int remainingBlackMoves,
+                  int remainingWhiteMoves);
+// Манхэттенское расстояние до угла, к которому идёт player
+constexpr int distanceToCorner(int x, int y, char player) {
+  int target = (player == 'B') ? 0 : board_size - 1;
+  return (x > target ? x - target : target - x) +
+         (y > target ? y - target : target - y);
+}
+// Ключ узла поиска: расстановка, сторона на ходу и оставшиеся ходы сторон
+uint64_t positionKey(const Position &pos, char player, int remainingBlackMoves,
+                     int remainingWhiteMoves);
 
 // Вспомогательные функции
 bool isInside(int x, int y);
-bool isValidMove(int x1, int y1, int x2, int y2, char player);
-bool makeMove(int x1, int y1, int x2, int y2, char player);
-bool checkWin(char player);
-
-// Глобальные переменные (extern)
-extern const int board_size;
-extern const int corner_size;
-extern std::vector<std::vector<char>> board;
-extern std::vector<std::vector<bool>> inOpponentCorner;
-extern int blackMoves;
-extern int whiteMoves;
-extern std::vector<std::string> moveHistory;
-extern size_t moveNumber;
+bool isValidMove(const Position &pos, int x1, int y1, int x2, int y2,
+                 char player);
+bool makeMove(Position &pos, int x1, int y1, int x2, int y2, char player);
+void makeMove(Position &pos, const Move &m, char player, Undo &undo);
+void unmakeMove(Position &pos, const Undo &undo, char player);
+bool checkWin(const Position &pos, char player);
+// Пропуск хода в партии: у player ещё есть ходы, но нет допустимого хода.
+// Ход при этом сгорает — так же считают поиск, точный перебор, таблицы
+// эндшпиля, доказательство и MCTS. false — пропуска нет (ход есть или
+// ходы кончились)
+bool passTurn(GameState &game, char player);
+// Целевой угол player: треугольник из pieces_per_side клеток
+uint64_t targetSquares(char player);
+// Фишки player в целевом углу: по ним и определяется победитель партии
+inline int piecesHome(const Position &pos, char player) {
+  return pos.home[colourIndex(player)];
+}
+
+// Границы итога партии. Фишки из угла не уходят, а каждый оставшийся ход
+// player (и сгоревший пропуск) приводит в угол не больше одной фишки:
+// больше этого фишек player в углу к концу партии не будет
+inline int maxPiecesHome(const Position &pos, char player,
+                         int remainingMoves) {
+  const int own = piecesHome(pos, player);
+  return own + std::min(remainingMoves, pieces_per_side - own);
+}
+
+// Перевес player к концу партии (его фишки в углу минус фишки соперника)
+// лежит в [lower, upper]. В конце партии и когда обе стороны заперты
+// границы совпадают
+inline void marginBounds(const Position &pos, char player,
+                         int remainingBlackMoves, int remainingWhiteMoves,
+                         int &lower, int &upper) {
+  const char opponent = player == 'B' ? 'W' : 'B';
+  const int remaining =
+      player == 'B' ? remainingBlackMoves : remainingWhiteMoves;
+  const int opponentRemaining =
+      player == 'B' ? remainingWhiteMoves : remainingBlackMoves;
+  lower = piecesHome(pos, player) -
+          maxPiecesHome(pos, opponent, opponentRemaining);
+  upper = maxPiecesHome(pos, player, remaining) - piecesHome(pos, opponent);
+}
+
+// Ограничения поиска: после мягкого срока новая итерация не начинается,
+// по жёсткому сроку текущая итерация прерывается
+struct SearchLimits {
+  int maxDepth = max_search_depth - 1;
+  int softTimeMs = 300;
+  int hardTimeMs = 500;
+  // Бюджет точного перебора до конца партии в узлах; если перебор в него
+  // не уложился, ход ищется обычным поиском. 0 — точный перебор выключен
+  uint64_t solverNodes = 1 << 20;
+  // Бюджет доказательства выигрыша числами доказательства (df-pn) в узлах
+  // для позиций дальше горизонта точного перебора. 0 — выключено
+  uint64_t proofNodes = 1 << 17;
+};
+
+// Счётчики и замеры последнего поиска. Каждый поток ведёт свои счётчики,
+// движок складывает их после поиска, поэтому в горячем пути нет общих
+// записей. Доля отсечений на первом ходе показывает качество
+// упорядочивания ходов
+struct SearchStats {
+  uint64_t nodes = 0;
+  // Листья, оценённые evaluateBoard
+  uint64_t leafEvals = 0;
+  uint64_t cutoffs = 0;
+  uint64_t firstMoveCutoffs = 0;
+  // Пробы таблицы транспозиций, найденные записи и отсечения по ним
+  uint64_t ttProbes = 0;
+  uint64_t ttHits = 0;
+  uint64_t ttCutoffs = 0;
+  uint64_t tablebaseHits = 0;
+  uint64_t proofNodes = 0;
+  // Глубина выбранного результата и наибольшее расстояние от корня
+  int depth = 0;
+  int selDepth = 0;
+  // Время поиска; для итераций главного потока — время от начала поиска
+  // до конца итерации и узлы главного потока к этому моменту
+  double timeMs = 0;
+  int iterations = 0;
+  double iterationMs[max_search_depth] = {};
+  uint64_t iterationNodes[max_search_depth] = {};
+  // Такты, инструкции и промахи всех потоков поиска, если они включены
+  // (Engine::setHardwareCounters)
+  HardwareCounters hardware;
+
+  // Складывает счётчики другого потока (итерации остаются свои)
+  void merge(const SearchStats &other);
+  double nodesPerSecond() const;
+  double firstMoveCutoffRate() const;
+  // Во сколько раз последняя итерация главного потока дороже
+  // предпоследней (по узлам с начала поиска); 0, если итераций меньше двух
+  double effectiveBranchingFactor() const;
+};
+
+// Параллельный поиск: Lazy SMP (потоки независимо ищут один корень через
+// общую таблицу) или YBWC (потоки делят ходы узлов после перебора старшего)
+enum class ParallelMode { LazySmp, Ybwc };
+
+struct SplitPoint;
+class OpeningBook;
+class ProofNumberSearch;
+class Tablebase;
+
+// Состояние одного потока поиска: свои счётчики, убийцы, история и
+// варианты. Общая у потоков только таблица транспозиций
+struct SearchWorker {
+  static constexpr int kKillerSlots = 2;
+
+  int id = 0;
+  SearchStats stats;
+  // Глубина, оценка (с точки зрения стороны на ходу) и вариант последней
+  // завершённой этим потоком итерации
+  int completedDepth = 0;
+  int completedScore = 0;
+  Move rootPv[max_search_depth];
+  int rootPvLength = 0;
+
+  // Треугольная таблица вариантов: pv[ply][ply..pvLength[ply]) — лучший
+  // вариант узла на расстоянии ply от корня
+  Move pv[max_search_depth][max_search_depth];
+  int pvLength[max_search_depth] = {};
+
+  Move killers[max_search_depth][kKillerSlots];
+  int history[2][64][64] = {};
+  // Зерно порядка тихих ходов с равной историей; у главного потока 0 —
+  // его порядок не меняется
+  uint32_t orderSeed = 0;
+
+  // YBWC: точка разделения, над которой поток сейчас работает, и стек
+  // опубликованных им точек. Владелец кладёт и снимает точки сверху,
+  // помощники берут работу у самых старых
+  const SplitPoint *activeSplit = nullptr;
+  std::mutex splitMutex;
+  SplitPoint *splits[max_search_depth];
+  int splitCount = 0;
+};
+
+// Общий интерфейс движков хода: альфа-бета (Engine) и MCTS (MctsEngine).
+// Через него движки играют друг с другом и сравниваются в бенчмарках
+class SearchEngine {
+public:
+  virtual ~SearchEngine() = default;
+
+  virtual void setLimits(const SearchLimits &limits) = 0;
+  virtual void setThreads(int count) = 0;
+  // Лучший ход для player ('B' или 'W'); позицию партии не меняет.
+  // false, если ходов нет
+  virtual bool findBestMove(const GameState &game, char player,
+                            Move &bestMove) = 0;
+  // Делает ход за player и записывает его в историю; false, если ходов нет
+  virtual bool makeAIMove(GameState &game, char player = 'B');
+
+  // Оценка выбранного хода с точки зрения чёрных, главный вариант и
+  // объём работы последнего поиска (узлы или партии-симуляции)
+  virtual int score() const = 0;
+  virtual const std::vector<Move> &principalVariation() const = 0;
+  virtual uint64_t nodes() const = 0;
+
+protected:
+  static void playMove(GameState &game, Move move, char player);
+};
+
+// Поиск хода компьютера. Всё изменяемое состояние поиска принадлежит
+// объекту, поэтому независимые движки можно запускать параллельно
+class Engine : public SearchEngine {
+public:
+  Engine();
+  ~Engine() override;
+
+  void setLimits(const SearchLimits &limits) override { limits_ = limits; }
+  const SearchLimits &limits() const { return limits_; }
+  // Размер таблицы транспозиций в мегабайтах
+  void setHashSizeMb(size_t sizeMb) { tt_.resize(sizeMb); }
+  // Размер таблицы чисел доказательства в мегабайтах
+  void setProofHashSizeMb(size_t sizeMb);
+  // Число потоков Lazy SMP; при 1 поиск идёт только в вызывающем потоке
+  void setThreads(int count) override;
+  int threads() const { return static_cast<int>(workers_.size()); }
+  // Таблицы эндшпиля (nullptr — без них); объект живёт дольше движка
+  void setTablebase(const Tablebase *tablebase) { tablebase_ = tablebase; }
+  // Дебютная книга (nullptr — без неё); объект живёт дольше движка
+  void setBook(const OpeningBook *book) { book_ = book; }
+  // Зерно случайного выбора хода из книги, для воспроизводимых партий
+  void setRandomSeed(uint64_t seed) { rng_.seed(seed); }
+  // Способ использовать помощников; выбирается перед поиском
+  void setParallelMode(ParallelMode mode) { mode_ = mode; }
+  ParallelMode parallelMode() const { return mode_; }
+  // Аппаратные счётчики perf_event_open на каждый поиск (только Linux);
+  // итог — в stats().hardware
+  void setHardwareCounters(bool enabled) { hardwareCounters_ = enabled; }
+
+  // Делает ход за player ('B' или 'W') из книги или найденный поиском;
+  // false, если ходов нет
+  bool makeAIMove(GameState &game, char player = 'B') override;
+  // Итеративное углубление: возвращает лучший ход последней завершённой
+  // итерации, позицию партии не меняет. Если идёт размышление над этой же
+  // позицией, оно продолжается со сроками хода, иначе прерывается
+  bool findBestMove(const GameState &game, char player,
+                    Move &bestMove) override;
+
+  // Размышление на времени соперника: player сейчас на ходу, его ответ
+  // берётся из главного варианта прошлого поиска, и в фоне ищется позиция
+  // после этого ответа. false, если предсказать ход нельзя. Пока идёт
+  // размышление, движок нельзя перенастраивать
+  bool startPondering(const GameState &game, char player);
+  void stopPondering();
+  bool isPondering() const { return ponderThread_.joinable(); }
+  Move ponderMove() const { return ponderMove_; }
+  // Сколько раз соперник сыграл предсказанный ход
+  int ponderHits() const { return ponderHits_; }
+  // Оценка позиции с точки зрения чёрных (как у evaluateBoard): обёртка
+  // над негамаксом для хода чёрных (isMaximizing) или белых. Идущее
+  // размышление прерывается
+  int minimax(Position &pos, int depth, bool isMaximizing, int alpha, int beta,
+              int remainingBlackMoves, int remainingWhiteMoves);
+
+  // Глубина, оценка (с точки зрения чёрных) и главный вариант выбранного
+  // результата последнего поиска; счётчики, сложенные по всем потокам
+  int completedDepth() const { return completedDepth_; }
+  int score() const override { return completedScore_; }
+  const std::vector<Move> &principalVariation() const override {
+    return rootPv_;
+  }
+  uint64_t nodes() const override { return stats_.nodes; }
+  // Последний результат — итог партии, а не эвристическая оценка: точный
+  // перебор или доказанный выигрыш (тогда оценка — гарантированный перевес)
+  bool solved() const { return solved_; }
+  // Статистика последнего поиска; после хода из книги — пустая
+  const SearchStats &stats() const { return stats_; }
+
+private:
+  // Ход из книги для позиции партии: случайный с учётом весов
+  bool probeBook(const GameState &game, char player, Move &move);
+  // Поиск со сроками, уже выставленными вызывающим; заполняет stats_
+  bool searchPosition(const GameState &game, char player, Move &bestMove);
+  // Негамакс с PVS: оценка с точки зрения player, ply — расстояние от корня
+  int search(SearchWorker &w, Position &pos, int depth, int ply, char player,
+             int alpha, int beta, int remainingBlackMoves,
+             int remainingWhiteMoves);
+  // Точный перебор до конца партии: MTD(f) по итогу партии — разнице
+  // фишек в целевых углах. false, если перебор не уложился в бюджет
+  bool solvePosition(SearchWorker &w, const GameState &game, char player,
+                     Move &bestMove);
+  // Доказательство выигрыша числами доказательства: player заканчивает
+  // партию с перевесом при любой игре соперника. false, если не доказано
+  bool provePosition(SearchWorker &w, const GameState &game, char player,
+                     Move &bestMove);
+  // Итог при лучшей игре с точки зрения player (fail-soft)
+  int solve(SearchWorker &w, Position &pos, int ply, char player, int alpha,
+            int beta, int remainingBlackMoves, int remainingWhiteMoves);
+  // Итеративное углубление одного потока с окнами аспирации
+  void iterate(SearchWorker &w, const GameState &game, char player,
+               int maxDepth);
+  // Результат главного потока или, если помощники ушли глубже, голосования
+  const SearchWorker &pickResult() const;
+
+  // YBWC: остановка из-за срока или отсечения выше по дереву, разбор
+  // ходов точки разделения и цикл помощника, ищущего чужие точки
+  bool shouldStop(const SearchWorker &w) const;
+  bool canSplit(const SearchWorker &w, int depth) const;
+  void searchSplitPoint(SearchWorker &w, SplitPoint &sp);
+  SplitPoint *stealSplitPoint(SearchWorker &thief);
+  void helperLoop(SearchWorker &w);
+
+  // Оценки для упорядочивания: ход из таблицы, прыжки вперёд по продвижению,
+  // ходы-убийцы этого полухода, остальные — по таблице истории
+  void scoreMoves(const SearchWorker &w, const MoveList &moves, char player,
+                  Move ttMove, int ply, int *scores) const;
+  void updateQuietCutoff(SearchWorker &w, Move m, char player, int depth,
+                         int ply);
+
+  SearchLimits limits_;
+  TranspositionTable tt_;
+  std::unique_ptr<ProofNumberSearch> pns_;
+  std::vector<std::unique_ptr<SearchWorker>> workers_;
+  ParallelMode mode_ = ParallelMode::LazySmp;
+  const Tablebase *tablebase_ = nullptr;
+  const OpeningBook *book_ = nullptr;
+  std::mt19937_64 rng_{std::random_device{}()};
+  std::atomic<int> idleHelpers_{0};
+  // Сроки в тиках steady_clock; при размышлении их нет до попадания
+  std::atomic<int64_t> softDeadline_{0};
+  std::atomic<int64_t> hardDeadline_{0};
+  // Сигнал остановки для всех потоков: жёсткий срок или конец поиска
+  std::atomic<bool> stop_{false};
+
+  SearchStats stats_;
+  bool hardwareCounters_ = false;
+  // Начало текущего поиска в тиках steady_clock, для замеров времени
+  int64_t searchStart_ = 0;
+  int completedDepth_ = 0;
+  int completedScore_ = 0;
+  std::vector<Move> rootPv_;
+  bool solved_ = false;
+  // Точный перебор прерван бюджетом, сроком или остановкой
+  bool solveAborted_ = false;
+
+  // Фоновый поиск позиции после предсказанного хода соперника
+  std::thread ponderThread_;
+  GameState ponderGame_;
+  char ponderPlayer_ = 'B';
+  Move ponderMove_;
+  Move ponderBest_;
+  bool ponderFound_ = false;
+  int ponderHits_ = 0;
+};
@@ -0,0 +1,270 @@
+/**
+ * @file bench_engine.cpp
+ * @brief Микробенчмарки примитивов движка без GUI.
+ *
+ * По набору позиций (дебют, миттельшпиль, гонка в конце партии — разделы
+ * файла отмечены комментариями) замеряет generateMoves, isValidMove,
+ * makeMove с отменой, evaluateBoard и checkWin в наносекундах на вызов,
+ * затем поиск на глубины 1..N (итеративное углубление без точного
+ * перебора и доказательства) в узлах в секунду. Каждый замер повторяется
+ * проходами по набору, пока не наберётся заданное время. Итог печатается
+ * таблицей и, с ключом --json=файл, пишется в JSON для истории замеров.
+ *
+ * Запуск: bench_engine [наибольшая глубина=5] [файл с позициями]
+ *                      [--json=файл] [--min-ms=200]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "ai.h"
+
+#ifndef UGOLKI_BENCH_CORPUS
+#define UGOLKI_BENCH_CORPUS "bench_positions.txt"
+#endif
+
+namespace {
+struct BenchPosition {
+  GameState game;
+  char side;
+  MoveList moves;
+};
+
+// Раздел набора: позиции с одним именем раздела подряд
+struct PositionSet {
+  std::string name;
+  std::vector<BenchPosition> positions;
+};
+
+// Результат вызовов накапливается сюда, чтобы компилятор их не выбросил
+volatile uint64_t sink;
+
+// Повторяет проход pass (возвращает число операций), пока не наберётся
+// minMs; итог — наносекунд на операцию
+double timePasses(const std::function<uint64_t()> &pass, double minMs,
+                  uint64_t &ops) {
+  using Clock = std::chrono::steady_clock;
+  ops = 0;
+  const Clock::time_point start = Clock::now();
+  double ms = 0;
+  do {
+    ops += pass();
+    ms = std::chrono::duration<double, std::milli>(Clock::now() - start)
+             .count();
+  } while (ms < minMs);
+  return ops ? ms * 1e6 / double(ops) : 0.0;
+}
+
+struct PrimitiveResult {
+  std::string name;
+  std::string set;
+  uint64_t ops;
+  double nsPerOp;
+};
+
+struct SearchResult {
+  int depth;
+  std::string set;
+  uint64_t nodes;
+  double ms;
+};
+
+void benchPrimitives(const PositionSet &set, double minMs,
+                     std::vector<PrimitiveResult> &results) {
+  const std::vector<BenchPosition> &positions = set.positions;
+  auto run = [&](const char *name, const std::function<uint64_t()> &pass) {
+    uint64_t ops;
+    double ns = timePasses(pass, minMs, ops);
+    results.push_back({name, set.name, ops, ns});
+  };
+
+  run("generateMoves", [&] {
+    uint64_t total = 0;
+    MoveList moves;
+    for (const BenchPosition &p : positions) {
+      generateMoves(p.game.board, p.side, moves);
+      total += moves.size();
+    }
+    sink = sink + total;
+    return uint64_t(positions.size());
+  });
+
+  // Половина проверок — ходы позиции, половина — их начала и концы,
+  // перемешанные между ходами (почти всегда недопустимые)
+  run("isValidMove", [&] {
+    uint64_t ops = 0, valid = 0;
+    for (const BenchPosition &p : positions) {
+      const int count = p.moves.size();
+      for (int i = 0; i < count; ++i) {
+        const Move m = p.moves[i], other = p.moves[(i * 7 + 3) % count];
+        valid += isValidMove(p.game.board, m.x1(), m.y1(), m.x2(), m.y2(),
+                             p.side);
+        valid += isValidMove(p.game.board, m.x1(), m.y1(), other.x2(),
+                             other.y2(), p.side);
+        ops += 2;
+      }
+    }
+    sink = sink + valid;
+    return ops;
+  });
+
+  run("makeMove+undo", [&] {
+    uint64_t ops = 0, keys = 0;
+    for (const BenchPosition &p : positions) {
+      Position pos = p.game.board;
+      for (Move m : p.moves) {
+        Undo undo;
+        makeMove(pos, m, p.side, undo);
+        keys += pos.key;
+        unmakeMove(pos, undo, p.side);
+      }
+      ops += p.moves.size();
+    }
+    sink = sink + keys;
+    return ops;
+  });
+
+  run("evaluateBoard", [&] {
+    uint64_t ops = 0;
+    int64_t total = 0;
+    for (const BenchPosition &p : positions)
+      for (int remaining = 0; remaining < 8; ++remaining) {
+        total += evaluateBoard(p.game.board, p.game.blackMoves - remaining,
+                               p.game.whiteMoves - remaining);
+        ++ops;
+      }
+    sink = sink + uint64_t(total);
+    return ops;
+  });
+
+  run("checkWin", [&] {
+    uint64_t wins = 0;
+    for (const BenchPosition &p : positions)
+      wins += checkWin(p.game.board, 'B') + checkWin(p.game.board, 'W');
+    sink = sink + wins;
+    return uint64_t(2 * positions.size());
+  });
+}
+
+// Поиск на глубину depth по всем позициям раздела. Новый движок на каждую
+// позицию: результаты не зависят от порядка; создание таблицы не замеряется
+SearchResult benchSearch(const PositionSet &set, int depth) {
+  SearchLimits limits;
+  limits.maxDepth = depth;
+  limits.softTimeMs = limits.hardTimeMs = 3600 * 1000;
+  limits.solverNodes = 0;
+  limits.proofNodes = 0;
+
+  SearchResult result = {depth, set.name, 0, 0.0};
+  for (const BenchPosition &p : set.positions) {
+    Engine engine;
+    engine.setLimits(limits);
+    Move best;
+    engine.findBestMove(p.game, p.side, best);
+    result.nodes += engine.stats().nodes;
+    result.ms += engine.stats().timeMs;
+  }
+  return result;
+}
+
+double nodesPerSecond(const SearchResult &r) {
+  return r.ms > 0 ? double(r.nodes) * 1000.0 / r.ms : 0.0;
+}
+
+bool writeJson(const std::string &path, const std::string &corpus,
+               const std::vector<PrimitiveResult> &primitives,
+               const std::vector<SearchResult> &searches) {
+  std::FILE *out = std::fopen(path.c_str(), "w");
+  if (!out)
+    return false;
+  std::fprintf(out, "{\n  \"corpus\": \"%s\",\n  \"primitives\": [",
+               corpus.c_str());
+  for (size_t i = 0; i < primitives.size(); ++i) {
+    const PrimitiveResult &r = primitives[i];
+    std::fprintf(out,
+                 "%s\n    {\"name\": \"%s\", \"set\": \"%s\", \"ops\": %llu, "
+                 "\"ns_per_op\": %.3f}",
+                 i ? "," : "", r.name.c_str(), r.set.c_str(),
+                 (unsigned long long)r.ops, r.nsPerOp);
+  }
+  std::fprintf(out, "\n  ],\n  \"search\": [");
+  for (size_t i = 0; i < searches.size(); ++i) {
+    const SearchResult &r = searches[i];
+    std::fprintf(out,
+                 "%s\n    {\"depth\": %d, \"set\": \"%s\", \"nodes\": %llu, "
+                 "\"ms\": %.3f, \"nodes_per_second\": %.0f}",
+                 i ? "," : "", r.depth, r.set.c_str(),
+                 (unsigned long long)r.nodes, r.ms, nodesPerSecond(r));
+  }
+  std::fprintf(out, "\n  ]\n}\n");
+  return std::fclose(out) == 0;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int maxDepth = 5;
+  double minMs = 200;
+  std::string corpus = UGOLKI_BENCH_CORPUS;
+  std::string jsonPath;
+  int positional = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strncmp(argv[i], "--json=", 7) == 0)
+      jsonPath = argv[i] + 7;
+    else if (std::strncmp(argv[i], "--min-ms=", 9) == 0)
+      minMs = std::atof(argv[i] + 9);
+    else if (positional++ == 0)
+      maxDepth = std::atoi(argv[i]);
+    else
+      corpus = argv[i];
+  }
+
+  std::vector<CorpusEntry> entries;
+  if (!loadCorpus(corpus, entries) || entries.empty())
+    return 1;
+  std::vector<PositionSet> sets;
+  for (const CorpusEntry &entry : entries) {
+    BenchPosition p;
+    p.game = entry.game;
+    p.side = entry.side;
+    generateMoves(p.game.board, p.side, p.moves);
+    if (sets.empty() || sets.back().name != entry.section)
+      sets.push_back({entry.section, {}});
+    sets.back().positions.push_back(p);
+  }
+
+  std::vector<PrimitiveResult> primitives;
+  std::printf("%-14s %-12s %14s %10s\n", "primitive", "set", "ops",
+              "ns/op");
+  for (const PositionSet &set : sets) {
+    const size_t first = primitives.size();
+    benchPrimitives(set, minMs, primitives);
+    for (size_t i = first; i < primitives.size(); ++i)
+      std::printf("%-14s %-12s %14llu %10.2f\n", primitives[i].name.c_str(),
+                  primitives[i].set.c_str(),
+                  (unsigned long long)primitives[i].ops,
+                  primitives[i].nsPerOp);
+  }
+
+  std::vector<SearchResult> searches;
+  std::printf("\n%-5s %-12s %14s %12s %12s\n", "depth", "set", "nodes", "ms",
+              "nodes/s");
+  for (int depth = 1; depth <= maxDepth; ++depth)
+    for (const PositionSet &set : sets) {
+      searches.push_back(benchSearch(set, depth));
+      const SearchResult &r = searches.back();
+      std::printf("%-5d %-12s %14llu %12.2f %12.0f\n", r.depth, r.set.c_str(),
+                  (unsigned long long)r.nodes, r.ms, nodesPerSecond(r));
+    }
+
+  if (!jsonPath.empty() &&
+      !writeJson(jsonPath, corpus, primitives, searches)) {
+    std::fprintf(stderr, "cannot write %s\n", jsonPath.c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,180 @@
+/**
+ * @file bench_search.cpp
+ * @brief Поиск на фиксированную глубину по набору позиций.
+ *
+ * Для каждой позиции из файла печатает число узлов, время, глубину и
+ * выборочную глубину, эффективный коэффициент ветвления, долю попаданий в
+ * таблицу транспозиций и отсечений на первом ходе, оценку и главный
+ * вариант, в конце — итог по всему набору.
+ * С ключом --threads=1,2,4,8,16 вместо этого прогоняет набор для каждого
+ * числа потоков и печатает ускорение времени до глубины; --mode=ybwc
+ * меняет параллельный поиск Lazy SMP на YBWC. --trace=файл записывает
+ * временную шкалу поиска для Perfetto (сборка с UGOLKI_TRACE). --perf
+ * добавляет аппаратные счётчики (Linux): инструкции за такт, промахи L1d и
+ * последнего уровня кэша и ошибки предсказания переходов на узел.
+ *
+ * Запуск: bench_search [глубина] [файл с позициями] [--threads=N,M,...]
+ *                      [--mode=lazysmp|ybwc] [--trace=файл] [--perf]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ai.h"
+#include "trace.h"
+
+#ifndef UGOLKI_BENCH_CORPUS
+#define UGOLKI_BENCH_CORPUS "bench_positions.txt"
+#endif
+
+namespace {
+double percent(uint64_t part, uint64_t total) {
+  return total ? 100.0 * double(part) / double(total) : 0.0;
+}
+
+// Аппаратные счётчики рядом со скоростью поиска
+void printHardware(const SearchStats &stats) {
+  if (!stats.hardware.valid) {
+    std::printf("  hardware counters unavailable");
+    return;
+  }
+  const double nodes = stats.nodes ? double(stats.nodes) : 1.0;
+  std::printf("  ipc %.2f  L1d %.1f  LLC %.2f  branch %.1f per node",
+              stats.hardware.ipc(), stats.hardware.l1Misses / nodes,
+              stats.hardware.llcMisses / nodes,
+              stats.hardware.branchMisses / nodes);
+}
+
+// Итог прогона набора: узлы, отсечения и суммарное время до глубины
+struct RunTotals {
+  SearchStats stats;
+  double ms = 0;
+};
+
+RunTotals runCorpus(const std::vector<CorpusEntry> &positions,
+                    int depth, int threads, ParallelMode mode, bool verbose,
+                    bool perf) {
+  SearchLimits limits;
+  limits.maxDepth = depth;
+  limits.softTimeMs = limits.hardTimeMs = 3600 * 1000;
+
+  RunTotals total;
+  int count = 0;
+  for (const auto &entry : positions) {
+    // новый движок на каждую позицию: результаты не зависят от порядка
+    Engine engine;
+    engine.setLimits(limits);
+    engine.setThreads(threads);
+    engine.setParallelMode(mode);
+    engine.setHardwareCounters(perf);
+    Move best;
+    auto start = std::chrono::steady_clock::now();
+    engine.findBestMove(entry.game, entry.side, best);
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+
+    const SearchStats &stats = engine.stats();
+    if (verbose) {
+      std::printf("%2d  %12llu nodes  %9.1f ms  depth %2d/%2d  ebf %5.2f  "
+                  "tt %5.1f%%  first %5.1f%%  score %5d  pv %s",
+                  ++count, (unsigned long long)stats.nodes, ms, stats.depth,
+                  stats.selDepth, stats.effectiveBranchingFactor(),
+                  percent(stats.ttHits, stats.ttProbes),
+                  100.0 * stats.firstMoveCutoffRate(), engine.score(),
+                  variationToString(engine.principalVariation()).c_str());
+      if (perf)
+        printHardware(stats);
+      std::printf("\n");
+    }
+    total.stats.merge(stats);
+    total.ms += ms;
+  }
+  return total;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int depth = 6;
+  std::string corpus = UGOLKI_BENCH_CORPUS;
+  std::vector<int> threadCounts;
+  ParallelMode mode = ParallelMode::LazySmp;
+  std::string tracePath;
+  bool perf = false;
+  int positional = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strncmp(argv[i], "--threads=", 10) == 0) {
+      for (const char *p = argv[i] + 10; p; p = std::strchr(p, ',')) {
+        if (*p == ',')
+          ++p;
+        threadCounts.push_back(std::atoi(p));
+      }
+    } else if (std::strcmp(argv[i], "--perf") == 0) {
+      perf = true;
+    } else if (std::strncmp(argv[i], "--trace=", 8) == 0) {
+      tracePath = argv[i] + 8;
+    } else if (std::strcmp(argv[i], "--mode=ybwc") == 0) {
+      mode = ParallelMode::Ybwc;
+    } else if (std::strcmp(argv[i], "--mode=lazysmp") == 0) {
+      mode = ParallelMode::LazySmp;
+    } else if (positional++ == 0) {
+      depth = std::atoi(argv[i]);
+    } else {
+      corpus = argv[i];
+    }
+  }
+
+  std::vector<CorpusEntry> positions;
+  if (!loadCorpus(corpus, positions))
+    return 1;
+  // Шкала пишется в конце прогона: кольцо хранит последние события
+  auto finish = [&tracePath] {
+    if (!tracePath.empty() && !writeTrace(tracePath.c_str())) {
+      std::fprintf(stderr, "cannot write trace %s (build with UGOLKI_TRACE)\n",
+                   tracePath.c_str());
+      return 1;
+    }
+    return 0;
+  };
+
+  if (threadCounts.empty()) {
+    RunTotals total = runCorpus(positions, depth, 1, mode, true, perf);
+    std::printf("depth %d, %d positions: %llu nodes, %.1f ms, %.0f nodes/s, "
+                "first-move cutoffs %.1f%%",
+                depth, int(positions.size()),
+                (unsigned long long)total.stats.nodes, total.ms,
+                total.ms > 0 ? total.stats.nodes * 1000.0 / total.ms : 0.0,
+                percent(total.stats.firstMoveCutoffs, total.stats.cutoffs));
+    if (perf)
+      printHardware(total.stats);
+    std::printf("\n");
+    return finish();
+  }
+
+  // Время до глубины: сколько нужно, чтобы главный поток закончил
+  // итерацию заданной глубины на каждой позиции набора
+  std::printf("%s time to depth %d, %d positions, %u hardware threads\n",
+              mode == ParallelMode::Ybwc ? "YBWC" : "Lazy SMP", depth,
+              int(positions.size()),
+              std::thread::hardware_concurrency());
+  double baseMs = 0;
+  for (int threads : threadCounts) {
+    RunTotals total = runCorpus(positions, depth, threads, mode, false, perf);
+    if (baseMs == 0)
+      baseMs = total.ms;
+    std::printf("threads %2d  %10.1f ms  speedup %5.2fx  %12llu nodes  "
+                "%.0f nodes/s",
+                threads, total.ms, total.ms > 0 ? baseMs / total.ms : 0.0,
+                (unsigned long long)total.stats.nodes,
+                total.ms > 0 ? total.stats.nodes * 1000.0 / total.ms : 0.0);
+    if (perf)
+      printHardware(total.stats);
+    std::printf("\n");
+  }
+  return finish();
+}
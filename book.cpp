@@ -0,0 +1,227 @@
+#include "book.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint64_t count;
+};
+static_assert(sizeof(Header) == 16, "заголовок пишется в файл как есть");
+
+constexpr char kMagic[4] = {'U', 'G', 'O', 'B'};
+constexpr uint32_t kVersion = 1;
+
+struct Candidate {
+  Move move;
+  int score;
+};
+
+// Общие для потоков результаты: оценённые позиции и число партий,
+// сыгравших каждый ход
+struct BookBuilder {
+  std::mutex lock;
+  std::map<uint64_t, std::vector<Candidate>> positions;
+  std::map<std::pair<uint64_t, uint16_t>, uint32_t> visits;
+};
+
+// Оценка всех ходов позиции поиском глубины depth; лучшие, не дальше
+// margin от лучшего, по убыванию оценки
+std::vector<Candidate> analyse(Engine &engine, const GameState &game,
+                               char player, const BookBuildOptions &options) {
+  const int childBlack = game.blackMoves - (player == 'B' ? 1 : 0);
+  const int childWhite = game.whiteMoves - (player == 'W' ? 1 : 0);
+  std::vector<Candidate> candidates;
+  for (Move m : generateMoves(game.board, player)) {
+    Position child = game.board;
+    Undo undo;
+    makeMove(child, m, player, undo);
+    // minimax оценивает с точки зрения чёрных, книга — стороны на ходу
+    int value = engine.minimax(child, options.depth - 1, player == 'W',
+                               -1000000, 1000000, childBlack, childWhite);
+    candidates.push_back({m, player == 'B' ? value : -value});
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate &a, const Candidate &b) {
+              return a.score > b.score;
+            });
+  size_t keep = 0;
+  while (keep < candidates.size() &&
+         keep < size_t(std::max(1, options.maxCandidates)) &&
+         candidates[keep].score >= candidates[0].score - options.margin)
+    ++keep;
+  candidates.resize(keep);
+  return candidates;
+}
+
+void playGames(BookBuilder &builder, const BookBuildOptions &options,
+               int games, unsigned seed) {
+  Engine engine;
+  SearchLimits limits;
+  limits.maxDepth = options.depth;
+  engine.setLimits(limits);
+  std::mt19937 rng(seed);
+
+  for (int g = 0; g < games; ++g) {
+    GameState game;
+    game.board = startPosition();
+    char player = 'W';
+    for (int ply = 0; ply < options.plies; ++ply) {
+      const uint64_t key = positionKey(game.board, player, game.blackMoves,
+                                       game.whiteMoves);
+      std::vector<Candidate> candidates;
+      {
+        std::lock_guard<std::mutex> guard(builder.lock);
+        auto it = builder.positions.find(key);
+        if (it != builder.positions.end())
+          candidates = it->second;
+      }
+      if (candidates.empty()) {
+        // позицию мог оценить и другой поток, результат совпадёт
+        candidates = analyse(engine, game, player, options);
+        if (candidates.empty())
+          break;
+        std::lock_guard<std::mutex> guard(builder.lock);
+        builder.positions.emplace(key, candidates);
+      }
+
+      // лучшие ходы выбираются чаще, но и остальные из книги играются
+      int total = 0;
+      for (const Candidate &c : candidates)
+        total += options.margin + 1 - (candidates[0].score - c.score);
+      int r = int(rng() % unsigned(total));
+      size_t pick = 0;
+      while (r >= options.margin + 1 -
+                      (candidates[0].score - candidates[pick].score)) {
+        r -= options.margin + 1 -
+             (candidates[0].score - candidates[pick].score);
+        ++pick;
+      }
+      const Move m = candidates[pick].move;
+      {
+        std::lock_guard<std::mutex> guard(builder.lock);
+        ++builder.visits[{key, m.data}];
+      }
+
+      makeMove(game.board, m.x1(), m.y1(), m.x2(), m.y2(), player);
+      if (player == 'B')
+        game.blackMoves--;
+      else
+        game.whiteMoves--;
+      player = player == 'B' ? 'W' : 'B';
+    }
+  }
+}
+} // namespace
+
+bool OpeningBook::open(const std::string &path) {
+  close();
+  if (!file_.open(path))
+    return false;
+  Header header;
+  if (file_.size() < sizeof(header)) {
+    file_.close();
+    return false;
+  }
+  std::memcpy(&header, file_.data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion ||
+      // делением: произведение счётчика из файла может переполниться
+      (file_.size() - sizeof(header)) / sizeof(BookEntry) < header.count) {
+    file_.close();
+    return false;
+  }
+  entries_ =
+      reinterpret_cast<const BookEntry *>(file_.data() + sizeof(header));
+  count_ = static_cast<size_t>(header.count);
+  return true;
+}
+
+void OpeningBook::close() {
+  file_.close();
+  entries_ = nullptr;
+  count_ = 0;
+}
+
+void OpeningBook::find(uint64_t key, const BookEntry *&first,
+                       const BookEntry *&last) const {
+  first = last = entries_;
+  if (!entries_)
+    return;
+  first = std::lower_bound(
+      entries_, entries_ + count_, key,
+      [](const BookEntry &e, uint64_t k) { return e.key < k; });
+  last = std::upper_bound(
+      first, entries_ + count_, key,
+      [](uint64_t k, const BookEntry &e) { return k < e.key; });
+}
+
+bool OpeningBook::pick(const BookEntry *first, const BookEntry *last,
+                       uint64_t random, Move &move) const {
+  uint64_t total = 0;
+  for (const BookEntry *e = first; e != last; ++e)
+    total += e->weight;
+  if (total == 0)
+    return false;
+  uint64_t r = random % total;
+  for (const BookEntry *e = first; e != last; ++e) {
+    if (r < e->weight) {
+      move = Move(e->move);
+      return true;
+    }
+    r -= e->weight;
+  }
+  return false;
+}
+
+bool buildOpeningBook(const std::string &path,
+                      const BookBuildOptions &options) {
+  BookBuilder builder;
+  const int threads = std::max(1, options.threads);
+  std::vector<std::thread> pool;
+  for (int t = 0; t < threads; ++t) {
+    // партии делятся между потоками поровну, остаток — первым
+    int games = options.games / threads + (t < options.games % threads);
+    pool.emplace_back(playGames, std::ref(builder), std::cref(options), games,
+                      unsigned(t + 1));
+  }
+  for (auto &t : pool)
+    t.join();
+
+  std::vector<BookEntry> entries;
+  for (const auto &position : builder.positions)
+    for (const Candidate &c : position.second) {
+      auto it = builder.visits.find({position.first, c.move.data});
+      uint32_t visits = it == builder.visits.end() ? 0 : it->second;
+      BookEntry e;
+      e.key = position.first;
+      e.move = c.move.data;
+      // несыгранные ходы из лучших остаются в книге с малым весом
+      e.weight = uint16_t(std::min<uint32_t>(visits + 1, UINT16_MAX));
+      e.score = c.score;
+      entries.push_back(e);
+    }
+  std::sort(entries.begin(), entries.end(),
+            [](const BookEntry &a, const BookEntry &b) {
+              return a.key != b.key ? a.key < b.key : a.weight > b.weight;
+            });
+
+  Header header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.count = entries.size();
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(entries.data()),
+            entries.size() * sizeof(BookEntry));
+  return bool(out);
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "ai.h"
+#include "mapped_file.h"
+
+// Запись дебютной книги. Файл — заголовок и записи, отсортированные по
+// ключу (ключ positionKey с оставшимися ходами сторон), у одного ключа —
+// по убыванию веса. score — оценка хода с точки зрения стороны на ходу
+struct BookEntry {
+  uint64_t key;
+  uint16_t move;
+  uint16_t weight;
+  int32_t score;
+};
+static_assert(sizeof(BookEntry) == 16,
+              "запись книги пишется в файл как есть");
+
+// Книга, отображённая в память: открытие ничего не читает, поиск позиции —
+// двоичный по отсортированным записям
+class OpeningBook {
+public:
+  bool open(const std::string &path);
+  void close();
+  bool isOpen() const { return entries_ != nullptr; }
+  size_t size() const { return count_; }
+
+  // Записи позиции: [first, last), пустой диапазон, если её нет в книге
+  void find(uint64_t key, const BookEntry *&first,
+            const BookEntry *&last) const;
+  // Ход из записей [first, last) одной позиции, найденных find, выбранный
+  // с вероятностью, пропорциональной весу; random — любое равномерно
+  // распределённое число
+  bool pick(const BookEntry *first, const BookEntry *last, uint64_t random,
+            Move &move) const;
+
+private:
+  MappedFile file_;
+  const BookEntry *entries_ = nullptr;
+  size_t count_ = 0;
+};
+
+// Параметры построения книги самоигрой
+struct BookBuildOptions {
+  int plies = 8;         // глубина книги в полуходах от начала партии
+  int depth = 5;         // глубина поиска при оценке каждого хода
+  int games = 128;       // партий самоигры
+  int threads = 1;       // потоков, играющих партии
+  int margin = 20;       // ходы хуже лучшего на большее не попадают в книгу
+  int maxCandidates = 3; // сколько лучших ходов позиции хранить
+};
+
+// Строит книгу: потоки играют партии от начальной расстановки, каждую
+// новую позицию оценивают поиском по всем ходам и выбирают ход случайно
+// среди лучших. Вес хода — сколько партий его сыграли. false при ошибке
+// записи файла
+bool buildOpeningBook(const std::string &path,
+                      const BookBuildOptions &options);
@@ -0,0 +1,48 @@
+/**
+ * @file bookgen.cpp
+ * @brief Построение дебютной книги самоигрой (без GUI).
+ *
+ * Потоки играют партии от начальной расстановки, оценивая каждую новую
+ * позицию поиском по всем ходам, и записывают лучшие ходы с весами в
+ * отсортированный файл, который игра отображает в память при запуске.
+ *
+ * Запуск: bookgen [файл=ugolki.book] [полуходов=8] [глубина=5] [партий=128]
+ *                 [потоки]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "book.h"
+
+int main(int argc, char **argv) {
+  std::string path = argc > 1 ? argv[1] : "ugolki.book";
+  BookBuildOptions options;
+  if (argc > 2)
+    options.plies = std::atoi(argv[2]);
+  if (argc > 3)
+    options.depth = std::atoi(argv[3]);
+  if (argc > 4)
+    options.games = std::atoi(argv[4]);
+  options.threads = argc > 5
+                        ? std::atoi(argv[5])
+                        : static_cast<int>(std::thread::hardware_concurrency());
+
+  std::printf("%s: %d plies, depth %d, %d games, %d threads\n", path.c_str(),
+              options.plies, options.depth, options.games, options.threads);
+  auto start = std::chrono::steady_clock::now();
+  if (!buildOpeningBook(path, options)) {
+    std::fprintf(stderr, "cannot write %s\n", path.c_str());
+    return 1;
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  OpeningBook book;
+  book.open(path);
+  std::printf("%zu entries in %.1f s\n", book.size(), seconds);
+  return 0;
+}
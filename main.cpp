@@ -8,9 +8,11 @@
 #include <SFML/Graphics.hpp>
 #include <windows.h>
 #include <string>
+#include <thread>
 #include "ai.h"
+#include "book.h"
+#include "tablebase.h"
 
-const int CORNER_SIZE = 4;
 const int cell_size = 160;
 const int border = 80;
 const int history_width = 320;
@@ -22,6 +24,11 @@ const int max_visible_moves = 50; // максимум отображаемых 
 int selectedX = -1, selectedY = -1;
 bool pieceSelected = false;
 bool playerTurn = true;
+GameState game; // позиция, лимиты и история текущей партии
+Tablebase tablebase; // таблицы эндшпиля, если рядом с exe есть ugolki.tb
+OpeningBook book; // дебютная книга, если рядом с exe есть ugolki.book
+Engine engine;  // поиск хода компьютера
+std::string expectedLine; // ожидаемое продолжение из главного варианта ИИ
 
 sf::Font font;
 sf::Texture boardBackgroundTexture;
@@ -35,20 +42,8 @@ sf::Sprite boardBackground;
  */
 
 void initBoard() {
-    // полностью очищаем доску
-    for (int i = 0; i < board_size; i++)
-        for (int j = 0; j < board_size; j++)
-            board[i][j] = '.';
-
-    // ставим белые фишки
-    for (int i = 0; i < CORNER_SIZE; ++i)
-        for (int j = 0; j < CORNER_SIZE - i; ++j)
-            board[i][j] = 'W';
-
-    // ставим черные фишки
-    for (int i = 0; i < CORNER_SIZE; ++i)
-        for (int j = 0; j < CORNER_SIZE - i; ++j)
-            board[board_size - 1 - i][board_size - 1 - j] = 'B';
+    // новая доска: без фишек прошлой партии и пометок запертых фишек
+    game.board = startPosition();
 }
 
 /**
@@ -73,10 +68,11 @@ void drawBoard(sf::RenderWindow &window,int selectedX,int selectedY,bool pieceSe
 			cell.setOutlineColor(sf::Color::Black); // цвет рамки
 
             window.draw(cell);
-            if(board[i][j]=='W'||board[i][j]=='B'){
+            char owner = game.board.at(i, j);
+            if(owner=='W'||owner=='B'){
                 sf::CircleShape piece(cell_size/2.f-20.f);
                 piece.setPosition(border+j*cell_size+20.f,border+(board_size-1-i)*cell_size+20.f);
-                piece.setFillColor(board[i][j]=='W'?sf::Color::White:sf::Color::Black);
+                piece.setFillColor(owner=='W'?sf::Color::White:sf::Color::Black);
                 window.draw(piece);
             }
         }
@@ -102,16 +98,22 @@ void drawBoard(sf::RenderWindow &window,int selectedX,int selectedY,bool pieceSe
     }
 
 	// вывод истории ходов с прокруткой
-	int totalMoves = static_cast<int>(moveHistory.size()); // убрали warning
+	int totalMoves = static_cast<int>(game.moveHistory.size()); // убрали warning
 	int start = std::max(0, totalMoves - max_visible_moves - scrollOffset);
 	int end   = std::min(totalMoves, start + max_visible_moves);
 
 	for (int i = start; i < end; i++) {
-		moveText.setString(moveHistory[i]);
+		moveText.setString(game.moveHistory[i]);
 		moveText.setPosition(window_size + 20.f, border + (i - start) * 25.f);
 		window.draw(moveText);
 	}
 
+    // ожидаемое продолжение партии под доской
+    if(!expectedLine.empty()){
+        moveText.setString("Expected: "+expectedLine);
+        moveText.setPosition(border*1.f,border+board_size*cell_size+45.f);
+        window.draw(moveText);
+    }
 }
 /**
  * @enum MenuState
@@ -307,20 +309,17 @@ void showGameOver(sf::RenderWindow &window, const std::string &resultText, sf::F
  * Выполняет повторную инициализацию доски, сброс истории ходов и состояния управления.
  */
 void resetGame() {
-    // расставляем фишки заново
+    // расставляем фишки заново (initBoard сбрасывает и запертые фишки)
     initBoard();
 
-    // сбрасываем пометки попадания в чужой угол (в ai.h у тебя inOpponentCorner)
-    for (int i = 0; i < board_size; ++i)
-        for (int j = 0; j < board_size; ++j)
-            inOpponentCorner[i][j] = false;
-
-    moveHistory.clear(); // очищаем историю и счётчик ходов
-    moveNumber = 0; // нумерация начнётся с 1 при первом успешном инкременте
-    whiteMoves = blackMoves = 20;// сбрасываем лимиты ходов
+    game.moveHistory.clear(); // очищаем историю и счётчик ходов
+    game.moveNumber = 0; // нумерация начнётся с 1 при первом успешном инкременте
+    game.whiteMoves = game.blackMoves = 20;// сбрасываем лимиты ходов
     playerTurn = true;// выставляем начальные состояния управления
     selectedX = selectedY = -1;// сброс выбранной клетки/состояния выбора
     pieceSelected = false;
+    expectedLine.clear();
+    engine.stopPondering(); // прошлая партия больше не нужна
 }
 /**
  * @brief Точка входа в Windows-приложение.
@@ -361,6 +360,14 @@ int WINAPI WinMain(HINSTANCE,HINSTANCE,LPSTR,int){
 
     // инициализация доски и всех игровых переменных только после меню
     initBoard();
+    // ИИ ищет ход на всех ядрах (Lazy SMP)
+    engine.setThreads(static_cast<int>(std::thread::hardware_concurrency()));
+    // таблицы отображаются в память, страницы читаются по мере обращения
+    if (tablebase.open("ugolki.tb"))
+        engine.setTablebase(&tablebase);
+    // книга тоже отображается в память: запуск её не читает
+    if (book.open("ugolki.book"))
+        engine.setBook(&book);
 
     if(!font.loadFromFile("DejaVuSans-Bold.ttf")){
         MessageBoxA(nullptr,"Failed to load font","Error",MB_ICONERROR);
@@ -374,17 +381,17 @@ int WINAPI WinMain(HINSTANCE,HINSTANCE,LPSTR,int){
             if(event.type==sf::Event::Closed) 
                 window.close();
 
-            if(playerTurn && whiteMoves>0 && event.type==sf::Event::MouseButtonPressed){
+            if(playerTurn && game.whiteMoves>0 && event.type==sf::Event::MouseButtonPressed){
                 int mouseX=event.mouseButton.x, mouseY=event.mouseButton.y;
                 int gridX=(board_size-1)-((mouseY-border)/cell_size);
                 int gridY=(mouseX-border)/cell_size;
                 if(isInside(gridX,gridY)){
-                    if(!pieceSelected && board[gridX][gridY]=='W'){
+                    if(!pieceSelected && game.board.at(gridX,gridY)=='W'){
                         selectedX=gridX; selectedY=gridY; pieceSelected=true;
                     }else if(pieceSelected){
-                        if(makeMove(selectedX,selectedY,gridX,gridY,'W')){
-                            moveNumber++; whiteMoves--;
-                            moveHistory.push_back(std::to_string(moveNumber)+". Player: "+
+                        if(makeMove(game.board,selectedX,selectedY,gridX,gridY,'W')){
+                            game.moveNumber++; game.whiteMoves--;
+                            game.moveHistory.push_back(std::to_string(game.moveNumber)+". Player: "+
                                                   std::string(1,'A'+selectedY)+std::to_string(selectedX+1)+
                                                   " -> "+std::string(1,'A'+gridY)+std::to_string(gridX+1));
                             pieceSelected=false; 
@@ -396,10 +403,26 @@ int WINAPI WinMain(HINSTANCE,HINSTANCE,LPSTR,int){
                 }
             }
 
-            if(!playerTurn && blackMoves>0){
-                if(!makeAIMove()) {
-                    moveNumber++; 
-                    moveHistory.push_back(std::to_string(moveNumber)+". AI: skipped");
+            // без допустимых ходов игрок пропускает ход, и ход сгорает
+            if(playerTurn && passTurn(game, 'W')){
+                game.moveHistory.push_back(std::to_string(game.moveNumber)+". Player: skipped");
+                pieceSelected=false;
+                playerTurn=false;
+            }
+
+            if(!playerTurn && game.blackMoves>0){
+                if(!engine.makeAIMove(game, 'B')) {
+                    passTurn(game, 'B');
+                    game.moveHistory.push_back(std::to_string(game.moveNumber)+". AI: skipped");
+                    expectedLine.clear();
+                } else {
+                    // первый ход варианта уже сделан, показываем ответы после него
+                    std::vector<Move> pv = engine.principalVariation();
+                    if(!pv.empty()) pv.erase(pv.begin());
+                    if(pv.size() > 8) pv.resize(8); // помещается под доской
+                    expectedLine = variationToString(pv);
+                    // пока игрок думает, ИИ ищет ответ на ожидаемый ход
+                    engine.startPondering(game, 'W');
                 }
                 playerTurn=true;
             }
@@ -408,7 +431,7 @@ int WINAPI WinMain(HINSTANCE,HINSTANCE,LPSTR,int){
             if (event.type == sf::Event::MouseWheelScrolled) {
                 if (event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel) {
                     if (event.mouseWheelScroll.delta > 0) {
-                        if (scrollOffset < (int)moveHistory.size() - max_visible_moves)
+                        if (scrollOffset < (int)game.moveHistory.size() - max_visible_moves)
                             scrollOffset++;
                     } else if (event.mouseWheelScroll.delta < 0) {
                         if (scrollOffset > 0)
@@ -424,16 +447,10 @@ int WINAPI WinMain(HINSTANCE,HINSTANCE,LPSTR,int){
 		window.display();
 
         // конец игры (как у тебя уже есть)
-		if (whiteMoves <= 0 && blackMoves <= 0) {
-			int whiteCount = 0, blackCount = 0;
-			for (int i = board_size - CORNER_SIZE; i < board_size; i++)
-				for (int j = board_size - CORNER_SIZE; j < board_size; j++)
-					if ((i + j) >= 2 * board_size - CORNER_SIZE - 1 && board[i][j] == 'W')
-						whiteCount++;
-			for (int i = 0; i < CORNER_SIZE; i++)
-				for (int j = 0; j < CORNER_SIZE; j++)
-					if ((i + j) <= CORNER_SIZE - 1 && board[i][j] == 'B')
-						blackCount++;
+		if (game.whiteMoves <= 0 && game.blackMoves <= 0) {
+			// счётчики фишек в целевых углах ведёт сама позиция
+			int whiteCount = piecesHome(game.board, 'W');
+			int blackCount = piecesHome(game.board, 'B');
 
 			std::string result;
 			if (whiteCount > blackCount) result = "WHITE wins (you)!";
@@ -443,6 +460,7 @@ int WINAPI WinMain(HINSTANCE,HINSTANCE,LPSTR,int){
 			result += "\nWHITE: " + std::to_string(whiteCount) +
 					  " BLACK: " + std::to_string(blackCount);
 
+			engine.stopPondering();
 			showGameOver(window, result, font); // показать экран конца игры
 
 			// возвращаемся в меню
@@ -0,0 +1,118 @@
+/**
+ * @file match.cpp
+ * @brief Матч альфа-беты (Engine) против MCTS (MctsEngine) без GUI.
+ *
+ * Каждая позиция набора бенчмарков доигрывается до конца дважды, со
+ * сменой цветов; движки получают одинаковое время на ход и число потоков.
+ * Для каждой партии печатается итог, в конце — счёт матча и средний объём
+ * работы движков за ход (узлы у альфа-беты, симуляции у MCTS).
+ *
+ * Запуск: match [мс на ход=100] [потоки=1] [файл с позициями]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ai.h"
+#include "mcts.h"
+
+#ifndef UGOLKI_BENCH_CORPUS
+#define UGOLKI_BENCH_CORPUS "bench_positions.txt"
+#endif
+
+namespace {
+// Работа движка за партию: сумма узлов (симуляций) и число ходов
+struct Effort {
+  uint64_t nodes = 0;
+  int moves = 0;
+};
+
+// Доигрывает партию; возвращает перевес чёрных в целевых углах
+int playGame(GameState game, char side, SearchEngine &black,
+             SearchEngine &white, Effort &blackEffort, Effort &whiteEffort) {
+  while (game.blackMoves > 0 || game.whiteMoves > 0) {
+    int &remaining = side == 'B' ? game.blackMoves : game.whiteMoves;
+    SearchEngine &engine = side == 'B' ? black : white;
+    Effort &effort = side == 'B' ? blackEffort : whiteEffort;
+    // при отсутствии ходов сторона пропускает ход, но лимит тратится
+    if (remaining > 0) {
+      if (engine.makeAIMove(game, side)) {
+        effort.nodes += engine.nodes();
+        ++effort.moves;
+      } else {
+        passTurn(game, side);
+      }
+    }
+    side = side == 'B' ? 'W' : 'B';
+  }
+  return piecesHome(game.board, 'B') - piecesHome(game.board, 'W');
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int moveMs = argc > 1 ? std::atoi(argv[1]) : 100;
+  int threads = argc > 2 ? std::atoi(argv[2]) : 1;
+  std::string corpus = argc > 3 ? argv[3] : UGOLKI_BENCH_CORPUS;
+
+  std::vector<CorpusEntry> positions;
+  if (!loadCorpus(corpus, positions))
+    return 1;
+
+  SearchLimits limits;
+  limits.softTimeMs = moveMs;
+  limits.hardTimeMs = moveMs * 5 / 3;
+
+  int wins = 0, draws = 0, losses = 0; // с точки зрения альфа-беты
+  Effort alphaBeta, mcts;
+  int game = 0;
+  for (const auto &entry : positions) {
+    for (char alphaBetaSide : {'B', 'W'}) {
+      // новые движки на каждую партию: партии не зависят друг от друга
+      Engine engine;
+      MctsEngine tree;
+      engine.setLimits(limits);
+      tree.setLimits(limits);
+      engine.setThreads(threads);
+      tree.setThreads(threads);
+      SearchEngine &black = alphaBetaSide == 'B'
+                                ? static_cast<SearchEngine &>(engine)
+                                : tree;
+      SearchEngine &white = alphaBetaSide == 'W'
+                                ? static_cast<SearchEngine &>(engine)
+                                : tree;
+      Effort blackEffort, whiteEffort;
+      int margin = playGame(entry.game, entry.side, black, white,
+                            blackEffort, whiteEffort);
+      Effort &a = alphaBetaSide == 'B' ? blackEffort : whiteEffort;
+      Effort &m = alphaBetaSide == 'B' ? whiteEffort : blackEffort;
+      alphaBeta.nodes += a.nodes;
+      alphaBeta.moves += a.moves;
+      mcts.nodes += m.nodes;
+      mcts.moves += m.moves;
+
+      int result = alphaBetaSide == 'B' ? margin : -margin;
+      if (result > 0)
+        ++wins;
+      else if (result < 0)
+        ++losses;
+      else
+        ++draws;
+      std::printf("%3d  alpha-beta %c  margin %+d  %s\n", ++game,
+                  alphaBetaSide, result,
+                  result > 0   ? "alpha-beta wins"
+                  : result < 0 ? "MCTS wins"
+                               : "draw");
+    }
+  }
+
+  std::printf("%d ms per move, %d threads: alpha-beta %d wins, %d draws, "
+              "%d losses\n",
+              moveMs, threads, wins, draws, losses);
+  std::printf("alpha-beta %.0f nodes per move, MCTS %.0f playouts per move\n",
+              alphaBeta.moves ? double(alphaBeta.nodes) / alphaBeta.moves : 0.0,
+              mcts.moves ? double(mcts.nodes) / mcts.moves : 0.0);
+  return 0;
+}
@@ -0,0 +1,405 @@
+#include "mcts.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <utility>
+
+namespace {
+// Состояния узла
+constexpr uint8_t kUnexpanded = 0;
+constexpr uint8_t kExpanding = 1;
+constexpr uint8_t kExpanded = 2;
+constexpr uint8_t kPoolFull = 3;
+
+// Виртуальная потеря: столько проигранных посещений добавляется узлам на
+// пути симуляции, пока она не вернула результат
+constexpr uint32_t kVirtualLoss = 3;
+// Лист раскрывается, набрав столько посещений; до того из него только
+// доигрываются партии
+constexpr uint32_t kExpandVisits = 8;
+// Вес исследования в формуле PUCT
+constexpr double kExploration = 1.5;
+// Температура априорных вероятностей: выигрыш по таблицам «фишка-клетка»,
+// при котором вероятность хода растёт в e раз
+constexpr double kPriorTemperature = 20.0;
+// Доля случайных ходов в жадных доигрываниях (из 256)
+constexpr uint64_t kRolloutRandom = 32;
+// Как часто (в симуляциях потока) сверяться с часами
+constexpr uint64_t kTimeCheckMask = 63;
+// Спуск длиннее партии: пропуски стороны без ходов тоже полуходы
+constexpr int kMaxPath = 2 * max_search_depth + 1;
+
+uint64_t nextRandom(uint64_t &state) {
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// Продвижение хода по таблицам «фишка-клетка» с точки зрения player
+int progressGain(Position &pos, Move m, char player) {
+  const int before = pos.score;
+  Undo undo;
+  makeMove(pos, m, player, undo);
+  const int gain = pos.score - before;
+  unmakeMove(pos, undo, player);
+  return player == 'B' ? gain : -gain;
+}
+
+void resetNode(MctsNode &node, Move move, float prior) {
+  node.visits.store(0, std::memory_order_relaxed);
+  node.wins.store(0, std::memory_order_relaxed);
+  node.state.store(kUnexpanded, std::memory_order_relaxed);
+  node.firstChild = 0;
+  node.childCount = 0;
+  node.move = move;
+  node.prior = prior;
+}
+} // namespace
+
+MctsEngine::MctsEngine(size_t poolMb) {
+  capacity_ = std::max<size_t>(1024, poolMb * 1024 * 1024 / 2 /
+                                         sizeof(MctsNode));
+  pools_[0].reset(new MctsNode[capacity_]);
+  pools_[1].reset(new MctsNode[capacity_]);
+}
+
+void MctsEngine::setThreads(int count) { threads_ = std::max(1, count); }
+
+size_t MctsEngine::treeSize() const {
+  return std::min(used_.load(std::memory_order_relaxed), capacity_);
+}
+
+void MctsEngine::applyMove(Walk &walk, Move m) {
+  int &remaining = walk.player == 'B' ? walk.remainingBlackMoves
+                                      : walk.remainingWhiteMoves;
+  if (m != Move()) {
+    Undo undo;
+    makeMove(walk.pos, m, walk.player, undo);
+  }
+  // пропуск без ходов сжигает ход; сторона, чьи ходы кончились, просто
+  // уступает очередь
+  if (remaining > 0)
+    --remaining;
+  walk.player = walk.player == 'B' ? 'W' : 'B';
+}
+
+void MctsEngine::prepareRoot(const GameState &game, char player) {
+  const uint64_t key =
+      positionKey(game.board, player, game.blackMoves, game.whiteMoves);
+  MctsNode *pool = pools_[current_].get();
+  reusedVisits_ = 0;
+
+  // Новая позиция ищется среди детей и внуков прошлого корня: обычно это
+  // наш прошлый ход и ответ соперника
+  uint32_t found = UINT32_MAX;
+  if (hasTree_ && key == rootKey_)
+    found = 0;
+  for (int depth = 1; hasTree_ && found == UINT32_MAX && depth <= 2; ++depth) {
+    const MctsNode &root = pool[0];
+    if (root.state.load(std::memory_order_relaxed) != kExpanded)
+      break;
+    for (int i = 0; i < root.childCount && found == UINT32_MAX; ++i) {
+      const MctsNode &child = pool[root.firstChild + i];
+      Walk walk = root_;
+      applyMove(walk, child.move);
+      if (depth == 1) {
+        if (positionKey(walk.pos, walk.player, walk.remainingBlackMoves,
+                        walk.remainingWhiteMoves) == key)
+          found = root.firstChild + i;
+        continue;
+      }
+      if (child.state.load(std::memory_order_relaxed) != kExpanded)
+        continue;
+      for (int j = 0; j < child.childCount; ++j) {
+        Walk next = walk;
+        applyMove(next, pool[child.firstChild + j].move);
+        if (positionKey(next.pos, next.player, next.remainingBlackMoves,
+                        next.remainingWhiteMoves) == key) {
+          found = child.firstChild + j;
+          break;
+        }
+      }
+    }
+  }
+
+  root_ = Walk{game.board, player, game.blackMoves, game.whiteMoves};
+  rootKey_ = key;
+  hasTree_ = true;
+  if (found == UINT32_MAX) {
+    resetNode(pool[0], Move(), 1.0f);
+    used_.store(1, std::memory_order_relaxed);
+    return;
+  }
+  if (found != 0) {
+    compactInto(found, 1 - current_);
+    current_ = 1 - current_;
+  }
+  reusedVisits_ = pools_[current_][0].visits.load(std::memory_order_relaxed);
+}
+
+void MctsEngine::compactInto(uint32_t from, int to) {
+  const MctsNode *src = pools_[current_].get();
+  MctsNode *dst = pools_[to].get();
+  auto copyNode = [](const MctsNode &s, MctsNode &d) {
+    resetNode(d, s.move, s.prior);
+    d.visits.store(s.visits.load(std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+    d.wins.store(s.wins.load(std::memory_order_relaxed),
+                 std::memory_order_relaxed);
+  };
+  // Обход в ширину: блок детей каждого узла переносится целиком, поэтому
+  // дети остаются подряд
+  copyNode(src[from], dst[0]);
+  std::vector<std::pair<uint32_t, uint32_t>> queue{{from, 0}};
+  uint32_t next = 1;
+  for (size_t q = 0; q < queue.size(); ++q) {
+    const MctsNode &s = src[queue[q].first];
+    MctsNode &d = dst[queue[q].second];
+    if (s.state.load(std::memory_order_relaxed) != kExpanded)
+      continue;
+    d.firstChild = next;
+    d.childCount = s.childCount;
+    d.state.store(kExpanded, std::memory_order_relaxed);
+    for (int i = 0; i < s.childCount; ++i) {
+      copyNode(src[s.firstChild + i], dst[next + i]);
+      queue.emplace_back(s.firstChild + i, next + i);
+    }
+    next += s.childCount;
+  }
+  used_.store(next, std::memory_order_relaxed);
+}
+
+void MctsEngine::expand(MctsNode &node, const Walk &walk) {
+  MoveList moves;
+  const int remaining = walk.player == 'B' ? walk.remainingBlackMoves
+                                           : walk.remainingWhiteMoves;
+  if (remaining > 0)
+    generateMoves(walk.pos, walk.player, moves);
+  const int count = std::max(1, moves.size());
+  const size_t first = used_.fetch_add(count, std::memory_order_relaxed);
+  if (first + count > capacity_) {
+    node.state.store(kPoolFull, std::memory_order_release);
+    return;
+  }
+
+  MctsNode *children = &pools_[current_][first];
+  if (moves.empty()) {
+    resetNode(children[0], Move(), 1.0f);
+  } else {
+    // Априорные вероятности — softmax продвижения ходов
+    Position pos = walk.pos;
+    int gains[max_moves];
+    int best = INT32_MIN;
+    for (int i = 0; i < count; ++i) {
+      gains[i] = progressGain(pos, moves[i], walk.player);
+      best = std::max(best, gains[i]);
+    }
+    double weights[max_moves];
+    double total = 0;
+    for (int i = 0; i < count; ++i) {
+      weights[i] = std::exp((gains[i] - best) / kPriorTemperature);
+      total += weights[i];
+    }
+    for (int i = 0; i < count; ++i)
+      resetNode(children[i], moves[i], float(weights[i] / total));
+  }
+  node.firstChild = static_cast<uint32_t>(first);
+  node.childCount = static_cast<uint16_t>(count);
+  node.state.store(kExpanded, std::memory_order_release);
+}
+
+MctsNode &MctsEngine::selectChild(const MctsNode &node) const {
+  MctsNode *children = &pools_[current_][node.firstChild];
+  // wins узла — за сторону, пришедшую в него; для стороны на ходу это
+  // поражения. Её средний результат — оценка ещё не посещённых детей
+  const uint32_t parentVisits = node.visits.load(std::memory_order_relaxed);
+  const uint32_t parentWins = node.wins.load(std::memory_order_relaxed);
+  const double unvisited =
+      parentVisits > kVirtualLoss
+          ? 1.0 - parentWins / (2.0 * (parentVisits - kVirtualLoss))
+          : 0.5;
+  const double scale = kExploration * std::sqrt(double(parentVisits) + 1);
+  int best = 0;
+  double bestValue = -1;
+  for (int i = 0; i < node.childCount; ++i) {
+    const MctsNode &child = children[i];
+    // виртуальные потери входят в посещения, но не в выигрыши
+    const uint32_t visits = child.visits.load(std::memory_order_relaxed);
+    const double q =
+        visits ? child.wins.load(std::memory_order_relaxed) / (2.0 * visits)
+               : unvisited;
+    const double value = q + scale * child.prior / (1 + visits);
+    if (value > bestValue) {
+      bestValue = value;
+      best = i;
+    }
+  }
+  return children[best];
+}
+
+int MctsEngine::rollout(Walk walk, uint64_t &rng) {
+  MoveList moves;
+  for (;;) {
+    // Исход решён, когда перевес не изменить оставшимися ходами
+    int lower, upper;
+    marginBounds(walk.pos, 'B', walk.remainingBlackMoves,
+                 walk.remainingWhiteMoves, lower, upper);
+    if (lower > 0)
+      return 2;
+    if (upper < 0)
+      return 0;
+    if (lower == upper)
+      return 1;
+
+    const int remaining = walk.player == 'B' ? walk.remainingBlackMoves
+                                             : walk.remainingWhiteMoves;
+    Move m;
+    if (remaining > 0) {
+      generateMoves(walk.pos, walk.player, moves);
+      if (!moves.empty()) {
+        // Жадная политика: ход с наибольшим продвижением, равные —
+        // случайно; изредка — совсем случайный ход
+        const uint64_t r = nextRandom(rng);
+        if ((r & 255) < kRolloutRandom) {
+          m = moves[int((r >> 8) % uint64_t(moves.size()))];
+        } else {
+          int bestGain = INT32_MIN, ties = 0;
+          for (Move candidate : moves) {
+            const int gain = progressGain(walk.pos, candidate, walk.player);
+            if (gain > bestGain) {
+              bestGain = gain;
+              m = candidate;
+              ties = 1;
+            } else if (gain == bestGain &&
+                       nextRandom(rng) % uint64_t(++ties) == 0) {
+              m = candidate;
+            }
+          }
+        }
+      }
+    }
+    applyMove(walk, m);
+  }
+}
+
+void MctsEngine::playout(uint64_t &rng) {
+  MctsNode *pool = pools_[current_].get();
+  MctsNode *path[kMaxPath];
+  char movers[kMaxPath];
+  int length = 0;
+
+  Walk walk = root_;
+  MctsNode *node = &pool[0];
+  node->visits.fetch_add(kVirtualLoss, std::memory_order_relaxed);
+  path[length] = node;
+  movers[length++] = root_.player == 'B' ? 'W' : 'B';
+  while (length < kMaxPath &&
+         (walk.remainingBlackMoves > 0 || walk.remainingWhiteMoves > 0)) {
+    uint8_t state = node->state.load(std::memory_order_acquire);
+    if (state == kUnexpanded) {
+      // лист сначала набирает посещения, корень раскрывается сразу
+      if (node != &pool[0] && node->visits.load(std::memory_order_relaxed) <
+                                  kVirtualLoss + kExpandVisits)
+        break;
+      uint8_t expected = kUnexpanded;
+      if (!node->state.compare_exchange_strong(expected, kExpanding,
+                                               std::memory_order_acq_rel))
+        break;
+      expand(*node, walk);
+      state = node->state.load(std::memory_order_acquire);
+    }
+    if (state != kExpanded)
+      break;
+    MctsNode &child = selectChild(*node);
+    const char mover = walk.player;
+    applyMove(walk, child.move);
+    node = &child;
+    node->visits.fetch_add(kVirtualLoss, std::memory_order_relaxed);
+    path[length] = node;
+    movers[length++] = mover;
+  }
+
+  const int result = rollout(walk, rng);
+  for (int i = 0; i < length; ++i) {
+    path[i]->wins.fetch_add(movers[i] == 'B' ? result : 2 - result,
+                            std::memory_order_relaxed);
+    path[i]->visits.fetch_sub(kVirtualLoss - 1, std::memory_order_relaxed);
+  }
+}
+
+void MctsEngine::worker(int id) {
+  uint64_t rng = seed_ ^ rootKey_ ^ (searches_ << 32) ^
+                 (uint64_t(id) * 0xD1B54A32D192ED03ULL);
+  for (uint64_t local = 1;; ++local) {
+    playout(rng);
+    const uint64_t total =
+        playoutCount_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (playoutLimit_ && total >= playoutLimit_)
+      stop_.store(true, std::memory_order_relaxed);
+    if ((local & kTimeCheckMask) == 0 &&
+        std::chrono::steady_clock::now() >= deadline_)
+      stop_.store(true, std::memory_order_relaxed);
+    if (stop_.load(std::memory_order_relaxed))
+      break;
+  }
+}
+
+bool MctsEngine::findBestMove(const GameState &game, char player,
+                              Move &bestMove) {
+  // Как у Engine: false только без ходов. Исчерпанный счётчик поиск
+  // обрабатывает сам — у корня остаётся один ребёнок-пропуск
+  MoveList rootMoves = generateMoves(game.board, player);
+  if (rootMoves.empty())
+    return false;
+  bestMove = rootMoves[0];
+  pv_.assign(1, bestMove);
+  score_ = 0;
+  playouts_ = 0;
+  if (rootMoves.size() == 1)
+    return true;
+
+  prepareRoot(game, player);
+  ++searches_;
+  deadline_ = std::chrono::steady_clock::now() +
+              std::chrono::milliseconds(limits_.softTimeMs);
+  stop_.store(false, std::memory_order_relaxed);
+  playoutCount_.store(0, std::memory_order_relaxed);
+  std::vector<std::thread> helpers;
+  for (int i = 1; i < threads_; ++i)
+    helpers.emplace_back([this, i] { worker(i); });
+  worker(0);
+  for (auto &t : helpers)
+    t.join();
+  playouts_ = playoutCount_.load(std::memory_order_relaxed);
+
+  // Ход — самый посещённый ребёнок корня; вариант идёт по самым
+  // посещённым детям до первого пропуска или нераскрытого узла
+  const MctsNode *pool = pools_[current_].get();
+  pv_.clear();
+  const MctsNode *node = &pool[0];
+  while (node->state.load(std::memory_order_relaxed) == kExpanded) {
+    const MctsNode *best = nullptr;
+    for (int i = 0; i < node->childCount; ++i) {
+      const MctsNode &child = pool[node->firstChild + i];
+      if (!best || child.visits.load(std::memory_order_relaxed) >
+                       best->visits.load(std::memory_order_relaxed))
+        best = &child;
+    }
+    if (best->visits.load(std::memory_order_relaxed) == 0 ||
+        best->move == Move())
+      break;
+    if (pv_.empty()) {
+      const double q = best->wins.load(std::memory_order_relaxed) /
+                       (2.0 * best->visits.load(std::memory_order_relaxed));
+      score_ = int(std::lround((2 * q - 1) * 1000)) * (player == 'B' ? 1 : -1);
+    }
+    pv_.push_back(best->move);
+    node = best;
+  }
+  if (pv_.empty())
+    pv_.assign(1, bestMove);
+  bestMove = pv_[0];
+  return true;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ai.h"
+
+// Узел дерева MCTS. Узлы живут в пуле движка, дети узла занимают в нём
+// подряд идущий блок. wins — удвоенные результаты симуляций (выигрыш 2,
+// ничья 1) с точки зрения стороны, сделавшей ход в узел. Ход Move() —
+// пропуск хода
+struct MctsNode {
+  std::atomic<uint32_t> visits{0};
+  std::atomic<uint32_t> wins{0};
+  // 0 — не раскрыт, 1 — раскрывается, 2 — раскрыт, 3 — в пуле нет места
+  std::atomic<uint8_t> state{0};
+  uint32_t firstChild = 0;
+  uint16_t childCount = 0;
+  Move move;
+  float prior = 0;
+};
+
+// Поиск Монте-Карло по дереву (PUCT): априорные вероятности ходов — по
+// продвижению к целевому углу, симуляции доигрывают партию жадной
+// политикой продвижения. Потоки спускаются по общему дереву; виртуальная
+// потеря на пути разводит их по разным ветвям. После хода поддерево
+// новой позиции переносится в свежий пул и продолжает накапливать
+// симуляции
+class MctsEngine : public SearchEngine {
+public:
+  // Память под оба пула узлов в мегабайтах
+  explicit MctsEngine(size_t poolMb = 64);
+
+  // Время поиска — мягкий срок лимитов, глубина не ограничивается
+  void setLimits(const SearchLimits &limits) override { limits_ = limits; }
+  void setThreads(int count) override;
+  int threads() const { return threads_; }
+  // Предел числа симуляций за поиск (0 — только по времени)
+  void setPlayoutLimit(uint64_t playouts) { playoutLimit_ = playouts; }
+  // Зерно генераторов симуляций, для воспроизводимых партий
+  void setRandomSeed(uint64_t seed) { seed_ = seed; }
+
+  bool findBestMove(const GameState &game, char player,
+                    Move &bestMove) override;
+
+  // Оценка — доля побед лучшего хода, переведённая в ±1000 в пользу чёрных
+  int score() const override { return score_; }
+  const std::vector<Move> &principalVariation() const override {
+    return pv_;
+  }
+  // Симуляции последнего поиска
+  uint64_t nodes() const override { return playouts_; }
+  // Симуляции в корне, унаследованные от прошлых поисков
+  uint64_t reusedVisits() const { return reusedVisits_; }
+  // Узлы дерева в пуле
+  size_t treeSize() const;
+
+private:
+  // Позиция узла при спуске: расстановка, сторона на ходу и ходы сторон
+  struct Walk {
+    Position pos;
+    char player;
+    int remainingBlackMoves;
+    int remainingWhiteMoves;
+  };
+
+  // Переносит в новый пул поддерево позиции game или начинает новое дерево
+  void prepareRoot(const GameState &game, char player);
+  // Поддерево с корнем from переписывается в пул to с корнем в узле 0
+  void compactInto(uint32_t from, int to);
+  // Дети узла: ходы с априорными вероятностями или один пропуск
+  void expand(MctsNode &node, const Walk &walk);
+  MctsNode &selectChild(const MctsNode &node) const;
+  // Одна симуляция: спуск, раскрытие, доигрывание и обратный проход
+  void playout(uint64_t &rng);
+  // Удвоенный результат доигрывания для чёрных: 2, 1 или 0
+  static int rollout(Walk walk, uint64_t &rng);
+  static void applyMove(Walk &walk, Move m);
+  void worker(int id);
+
+  SearchLimits limits_;
+  int threads_ = 1;
+  uint64_t playoutLimit_ = 0;
+  uint64_t seed_ = 0x5EED;
+
+  // Два пула: текущий и пул, в который переносится дерево при повторном
+  // использовании
+  std::unique_ptr<MctsNode[]> pools_[2];
+  int current_ = 0;
+  size_t capacity_ = 0;
+  std::atomic<size_t> used_{0};
+
+  Walk root_ = {};
+  uint64_t rootKey_ = 0;
+  bool hasTree_ = false;
+
+  std::atomic<uint64_t> playoutCount_{0};
+  std::atomic<bool> stop_{false};
+  std::chrono::steady_clock::time_point deadline_;
+  uint64_t searches_ = 0;
+
+  int score_ = 0;
+  std::vector<Move> pv_;
+  uint64_t playouts_ = 0;
+  uint64_t reusedVisits_ = 0;
+};
@@ -0,0 +1,115 @@
+#include "perf_counters.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#endif
+
+void HardwareCounters::merge(const HardwareCounters &other) {
+  cycles += other.cycles;
+  instructions += other.instructions;
+  l1Misses += other.l1Misses;
+  llcMisses += other.llcMisses;
+  branchMisses += other.branchMisses;
+  valid |= other.valid;
+}
+
+double HardwareCounters::ipc() const {
+  return cycles ? double(instructions) / double(cycles) : 0.0;
+}
+
+#if defined(__linux__)
+namespace {
+// Порядок событий совпадает с полями HardwareCounters; первое — лидер
+struct EventConfig {
+  uint32_t type;
+  uint64_t config;
+};
+
+constexpr EventConfig kConfigs[] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                             PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                             PERF_COUNT_HW_CACHE_RESULT_MISS << 16},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}};
+
+int openEvent(const EventConfig &event, int groupFd) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = event.type;
+  attr.config = event.config;
+  // группа создаётся выключенной и включается целиком
+  attr.disabled = groupFd == -1 ? 1 : 0;
+  // ядро и гипервизор не считаем: хватает perf_event_paranoid <= 2
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING | PERF_FORMAT_ID;
+  // pid 0, cpu -1: вызывающий поток на любом процессоре
+  return int(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+}
+} // namespace
+
+bool PerfCounterGroup::start() {
+  close();
+  fds_[0] = openEvent(kConfigs[0], -1);
+  if (fds_[0] < 0)
+    return false;
+  for (int i = 1; i < kEvents; ++i)
+    fds_[i] = openEvent(kConfigs[i], fds_[0]);
+  ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  return true;
+}
+
+void PerfCounterGroup::stop(HardwareCounters &counters) {
+  if (fds_[0] < 0)
+    return;
+  ioctl(fds_[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+  // Формат чтения группы: число событий, время включения и работы, затем
+  // пары «значение, идентификатор» в порядке открытия
+  uint64_t buffer[3 + 2 * kEvents] = {};
+  const ssize_t size = read(fds_[0], buffer, sizeof(buffer));
+  uint64_t ids[kEvents] = {};
+  for (int i = 0; i < kEvents; ++i)
+    if (fds_[i] >= 0)
+      ioctl(fds_[i], PERF_EVENT_IOC_ID, &ids[i]);
+  close();
+  // группа ни разу не попала на процессор: значений нет
+  if (size < ssize_t(3 * sizeof(uint64_t)) || buffer[2] == 0)
+    return;
+
+  const uint64_t count = buffer[0];
+  const double scale = double(buffer[1]) / double(buffer[2]);
+  uint64_t *fields[kEvents] = {&counters.cycles, &counters.instructions,
+                               &counters.l1Misses, &counters.llcMisses,
+                               &counters.branchMisses};
+  for (uint64_t k = 0; k < count && k < uint64_t(kEvents); ++k) {
+    const uint64_t value = buffer[3 + 2 * k], id = buffer[4 + 2 * k];
+    for (int i = 0; i < kEvents; ++i)
+      if (id != 0 && ids[i] == id)
+        *fields[i] += uint64_t(double(value) * scale);
+  }
+  counters.valid = true;
+}
+
+void PerfCounterGroup::close() {
+  for (int &fd : fds_) {
+    if (fd >= 0)
+      ::close(fd);
+    fd = -1;
+  }
+}
+#else
+bool PerfCounterGroup::start() { return false; }
+void PerfCounterGroup::stop(HardwareCounters &) {}
+void PerfCounterGroup::close() {}
+#endif
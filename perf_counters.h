@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+
+// Аппаратные счётчики за время поиска. valid — счётчики удалось открыть;
+// иначе (не Linux, нет PMU, запрет perf_event_paranoid) все поля нулевые
+struct HardwareCounters {
+  uint64_t cycles = 0;
+  uint64_t instructions = 0;
+  uint64_t l1Misses = 0;
+  uint64_t llcMisses = 0;
+  uint64_t branchMisses = 0;
+  bool valid = false;
+
+  void merge(const HardwareCounters &other);
+  // Инструкций за такт
+  double ipc() const;
+};
+
+// Группа счётчиков perf_event_open (только Linux) для вызывающего потока:
+// такты, инструкции, промахи L1d и последнего уровня кэша, ошибки
+// предсказания переходов. Открывается и читается в измеряемом потоке.
+// Если ядро мультиплексирует счётчики, значения масштабируются на время
+// работы группы
+class PerfCounterGroup {
+public:
+  PerfCounterGroup() = default;
+  ~PerfCounterGroup() { close(); }
+  PerfCounterGroup(const PerfCounterGroup &) = delete;
+  PerfCounterGroup &operator=(const PerfCounterGroup &) = delete;
+
+  // Открывает группу и запускает счёт; false — счётчики недоступны.
+  // Недоступные члены группы (кроме тактов) пропускаются
+  bool start();
+  // Останавливает счёт, прибавляет значения к counters и закрывает группу
+  void stop(HardwareCounters &counters);
+
+private:
+  static constexpr int kEvents = 5;
+
+  void close();
+
+  int fds_[kEvents] = {-1, -1, -1, -1, -1};
+};
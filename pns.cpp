@@ -0,0 +1,302 @@
+#include "pns.h"
+
+#include <algorithm>
+
+namespace {
+// Как часто (в узлах) спрашивать, не пора ли остановиться
+constexpr uint64_t kAbortCheckMask = 1023;
+
+// Ключи решателя отличаются от ключей поиска и точного перебора и
+// зависят от цели: записи разных вопросов не смешиваются
+constexpr uint64_t kProofKey = 0xD1B54A32D192ED03ULL;
+
+uint64_t goalSalt(char attacker, ProofGoal goal, int target) {
+  uint64_t z = kProofKey + uint64_t(target + 64) * 4 +
+               (goal == ProofGoal::Margin ? 2 : 0) + (attacker == 'B' ? 1 : 0);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// Номер старшего бита плюс один: «порядок» размера поддерева записи
+int workClass(uint32_t work) {
+  int bits = 0;
+  for (; work; work >>= 1)
+    ++bits;
+  return bits;
+}
+} // namespace
+
+ProofTable::ProofTable(size_t sizeMb) { resize(sizeMb); }
+
+void ProofTable::resize(size_t sizeMb) {
+  if (sizeMb == 0)
+    sizeMb = 1;
+  // число корзин — наибольшая степень двойки, помещающаяся в sizeMb
+  size_t count = 1;
+  while (count * 2 * sizeof(Bucket) <= sizeMb * 1024 * 1024)
+    count *= 2;
+  buckets_.reset(new Bucket[count]);
+  mask_ = count - 1;
+  sizeMb_ = sizeMb;
+  used_ = 0;
+  collections_ = 0;
+}
+
+void ProofTable::clear() {
+  for (size_t i = 0; i <= mask_; ++i)
+    for (Entry &e : buckets_[i].entries)
+      e = Entry();
+  used_ = 0;
+}
+
+const ProofTable::Entry *ProofTable::probe(uint64_t key) const {
+  for (const Entry &e : bucketFor(key).entries)
+    if (e.key == key)
+      return &e;
+  return nullptr;
+}
+
+void ProofTable::store(uint64_t key, uint32_t pn, uint32_t dn, uint32_t work,
+                       uint16_t move) {
+  Bucket &bucket = bucketFor(key);
+  Entry *replace = nullptr;
+  for (Entry &e : bucket.entries)
+    if (e.key == key) {
+      replace = &e;
+      // поддерево узла растёт с каждым раскрытием
+      work = std::max(work, e.work);
+      break;
+    }
+  if (!replace)
+    for (Entry &e : bucket.entries)
+      if (e.key == 0) {
+        replace = &e;
+        ++used_;
+        break;
+      }
+  if (!replace) {
+    // корзина полна: вытесняем запись с самым маленьким поддеревом
+    replace = &bucket.entries[0];
+    for (Entry &e : bucket.entries)
+      if (e.work < replace->work)
+        replace = &e;
+  }
+  replace->key = key;
+  replace->pn = pn;
+  replace->dn = dn;
+  replace->work = work;
+  replace->move = move;
+  if (used_ >= capacity() * kCollectFill)
+    collect();
+}
+
+void ProofTable::collect() {
+  // Порог выбирается по гистограмме порядков поддеревьев: удаляются все
+  // записи порядка не выше порога, и их хотя бы половина занятых
+  size_t histogram[33] = {};
+  for (size_t i = 0; i <= mask_; ++i)
+    for (const Entry &e : buckets_[i].entries)
+      if (e.key != 0)
+        ++histogram[workClass(e.work)];
+  int threshold = 0;
+  for (size_t removed = histogram[0]; removed * 2 < used_ && threshold < 32;)
+    removed += histogram[++threshold];
+
+  for (size_t i = 0; i <= mask_; ++i)
+    for (Entry &e : buckets_[i].entries)
+      if (e.key != 0 && workClass(e.work) <= threshold) {
+        e = Entry();
+        --used_;
+      }
+  ++collections_;
+}
+
+uint64_t ProofNumberSearch::keyOf(const Position &pos, char player,
+                                  int remainingBlackMoves,
+                                  int remainingWhiteMoves) const {
+  return positionKey(pos, player, remainingBlackMoves, remainingWhiteMoves) ^
+         salt_;
+}
+
+void ProofNumberSearch::goalBounds(const Position &pos,
+                                   int remainingBlackMoves,
+                                   int remainingWhiteMoves, int &lower,
+                                   int &upper) const {
+  if (goal_ == ProofGoal::Margin) {
+    marginBounds(pos, attacker_, remainingBlackMoves, remainingWhiteMoves,
+                 lower, upper);
+    return;
+  }
+  lower = piecesHome(pos, attacker_);
+  upper = maxPiecesHome(pos, attacker_,
+                        attacker_ == 'B' ? remainingBlackMoves
+                                         : remainingWhiteMoves);
+}
+
+bool ProofNumberSearch::isTerminal(const Position &pos,
+                                   int remainingBlackMoves,
+                                   int remainingWhiteMoves, uint32_t &pn,
+                                   uint32_t &dn) const {
+  int lower, upper;
+  goalBounds(pos, remainingBlackMoves, remainingWhiteMoves, lower, upper);
+  if (lower >= target_) {
+    pn = 0;
+    dn = kProofInfinity;
+    return true;
+  }
+  if (upper < target_) {
+    pn = kProofInfinity;
+    dn = 0;
+    return true;
+  }
+  return false;
+}
+
+void ProofNumberSearch::lookup(const Position &pos, char player,
+                               int remainingBlackMoves,
+                               int remainingWhiteMoves, uint32_t &pn,
+                               uint32_t &dn, uint16_t *move) const {
+  if (isTerminal(pos, remainingBlackMoves, remainingWhiteMoves, pn, dn))
+    return;
+  if (const ProofTable::Entry *e = table_.probe(
+          keyOf(pos, player, remainingBlackMoves, remainingWhiteMoves))) {
+    pn = e->pn;
+    dn = e->dn;
+    if (move)
+      *move = e->move;
+    return;
+  }
+  // Новый узел (df-pn+): доказать тем труднее, чем дальше от цели нижняя
+  // граница, опровергнуть — чем дальше верхняя
+  int lower, upper;
+  goalBounds(pos, remainingBlackMoves, remainingWhiteMoves, lower, upper);
+  pn = static_cast<uint32_t>(target_ - lower);
+  dn = static_cast<uint32_t>(upper - target_ + 1);
+}
+
+void ProofNumberSearch::mid(Position &pos, char player,
+                            int remainingBlackMoves, int remainingWhiteMoves,
+                            uint32_t thresholdPn, uint32_t thresholdDn) {
+  if (++nodes_ >= maxNodes_ ||
+      ((nodes_ & kAbortCheckMask) == 0 && *abort_ && (*abort_)()))
+    aborted_ = true;
+  if (aborted_)
+    return;
+  const uint64_t startNodes = nodes_;
+
+  // У узла attacker (ИЛИ) доказательство — минимум по детям, опровержение —
+  // сумма; у узла соперника (И) наоборот. Ниже «min» и «sum» — эти числа
+  const bool orNode = player == attacker_;
+  const char opponent = player == 'B' ? 'W' : 'B';
+  const int remaining =
+      player == 'B' ? remainingBlackMoves : remainingWhiteMoves;
+  int childBlack = remainingBlackMoves, childWhite = remainingWhiteMoves;
+  MoveList moves;
+  // ходы кончились только у этой стороны: ходит соперник. Без ходов
+  // сторона пропускает ход, но ход у неё сгорает
+  if (remaining > 0) {
+    generateMoves(pos, player, moves);
+    childBlack -= player == 'B' ? 1 : 0;
+    childWhite -= player == 'W' ? 1 : 0;
+  }
+  const int count = std::max(1, moves.size());
+
+  uint32_t pn = 0, dn = 0;
+  int best = 0;
+  for (;;) {
+    uint32_t minValue = kProofInfinity, second = kProofInfinity;
+    uint32_t bestSum = 0;
+    uint64_t sum = 0;
+    bool infinite = false;
+    for (int i = 0; i < count; ++i) {
+      uint32_t childPn, childDn;
+      if (moves.empty()) {
+        lookup(pos, opponent, childBlack, childWhite, childPn, childDn);
+      } else {
+        Undo undo;
+        makeMove(pos, moves[i], player, undo);
+        lookup(pos, opponent, childBlack, childWhite, childPn, childDn);
+        unmakeMove(pos, undo, player);
+      }
+      const uint32_t value = orNode ? childPn : childDn;
+      const uint32_t other = orNode ? childDn : childPn;
+      sum += other;
+      infinite |= other >= kProofInfinity;
+      if (value < minValue) {
+        second = minValue;
+        minValue = value;
+        bestSum = other;
+        best = i;
+      } else if (value < second) {
+        second = value;
+      }
+    }
+    // сумма без бесконечных слагаемых остаётся конечной
+    const uint32_t total =
+        infinite ? kProofInfinity
+                 : uint32_t(std::min<uint64_t>(sum, kProofInfinity - 1));
+    pn = orNode ? minValue : total;
+    dn = orNode ? total : minValue;
+    if (pn >= thresholdPn || dn >= thresholdDn)
+      break;
+
+    // Лучший ребёнок раскрывается, пока не станет хуже второго или пока
+    // сумма не дойдёт до порога узла
+    const uint32_t minThreshold =
+        std::min(orNode ? thresholdPn : thresholdDn, second + 1);
+    const uint32_t sumThreshold =
+        (orNode ? thresholdDn : thresholdPn) - total + bestSum;
+    const uint32_t childThresholdPn = orNode ? minThreshold : sumThreshold;
+    const uint32_t childThresholdDn = orNode ? sumThreshold : minThreshold;
+    if (moves.empty()) {
+      mid(pos, opponent, childBlack, childWhite, childThresholdPn,
+          childThresholdDn);
+    } else {
+      Undo undo;
+      makeMove(pos, moves[best], player, undo);
+      mid(pos, opponent, childBlack, childWhite, childThresholdPn,
+          childThresholdDn);
+      unmakeMove(pos, undo, player);
+    }
+    if (aborted_)
+      return;
+  }
+
+  const uint64_t work = nodes_ - startNodes + 1;
+  table_.store(keyOf(pos, player, remainingBlackMoves, remainingWhiteMoves),
+               pn, dn, uint32_t(std::min<uint64_t>(work, UINT32_MAX)),
+               moves.empty() ? 0 : moves[best].data);
+}
+
+ProofResult ProofNumberSearch::prove(const GameState &game, char player,
+                                     char attacker, ProofGoal goal,
+                                     int target,
+                                     uint64_t maxNodes, Move &bestMove,
+                                     const std::function<bool()> &abort) {
+  attacker_ = attacker;
+  goal_ = goal;
+  target_ = target;
+  salt_ = goalSalt(attacker, goal, target);
+  maxNodes_ = maxNodes;
+  nodes_ = 0;
+  aborted_ = false;
+  abort_ = &abort;
+  bestMove = Move();
+
+  Position pos = game.board;
+  uint32_t pn, dn;
+  if (!isTerminal(pos, game.blackMoves, game.whiteMoves, pn, dn))
+    mid(pos, player, game.blackMoves, game.whiteMoves, kProofInfinity,
+        kProofInfinity);
+  abort_ = nullptr;
+
+  uint16_t move = 0;
+  lookup(pos, player, game.blackMoves, game.whiteMoves, pn, dn, &move);
+  bestMove = Move(move);
+  if (pn == 0)
+    return ProofResult::Proven;
+  if (dn == 0)
+    return ProofResult::Disproven;
+  return ProofResult::Unknown;
+}
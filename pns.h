@@ -0,0 +1,121 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "ai.h"
+
+// Поиск по числам доказательства в глубину (df-pn) для вопросов «да/нет»
+// о конце партии, заданных целью стороны attacker:
+// - PiecesHome: довести до своего целевого угла не меньше target фишек;
+// - Margin: закончить партию с перевесом фишек в углах не меньше target
+//   (target = 1 — «выигрывает ли attacker»).
+// Фишки из угла не уходят, а ход приводит в угол не больше одной фишки,
+// поэтому узел часто решается по счёту и оставшимся ходам без перебора.
+// Правила конца партии те же, что у точного перебора: сторона без ходов
+// пропускает ход, и ход у неё сгорает
+enum class ProofGoal { PiecesHome, Margin };
+enum class ProofResult { Proven, Disproven, Unknown };
+
+// Числа доказательства и опровержения узла; kProofInfinity — узел решён
+constexpr uint32_t kProofInfinity = 1u << 30;
+
+// Таблица чисел доказательства ограниченного размера. Запись помнит,
+// сколько узлов ушло на её поддерево. Когда таблица заполнена на
+// kCollectFill, сборка мусора удаляет записи с самыми маленькими
+// поддеревьями, пока не освободится хотя бы половина занятых
+class ProofTable {
+public:
+  struct Entry {
+    uint64_t key = 0; // 0 — запись свободна
+    uint32_t pn = 0;
+    uint32_t dn = 0;
+    uint32_t work = 0;
+    uint16_t move = 0;
+  };
+
+  explicit ProofTable(size_t sizeMb = 4);
+
+  // Новый размер в мегабайтах; содержимое очищается
+  void resize(size_t sizeMb);
+  void clear();
+
+  const Entry *probe(uint64_t key) const;
+  void store(uint64_t key, uint32_t pn, uint32_t dn, uint32_t work,
+             uint16_t move);
+
+  size_t used() const { return used_; }
+  size_t capacity() const { return (mask_ + 1) * kBucketSize; }
+  // Сколько раз запускалась сборка мусора
+  uint64_t collections() const { return collections_; }
+  size_t sizeMb() const { return sizeMb_; }
+
+private:
+  static constexpr int kBucketSize = 4;
+  static constexpr double kCollectFill = 0.9;
+
+  struct Bucket {
+    Entry entries[kBucketSize];
+  };
+
+  Bucket &bucketFor(uint64_t key) const { return buckets_[key & mask_]; }
+  void collect();
+
+  std::unique_ptr<Bucket[]> buckets_;
+  size_t mask_ = 0;
+  size_t used_ = 0;
+  size_t sizeMb_ = 0;
+  uint64_t collections_ = 0;
+};
+
+// Решатель с собственной таблицей; таблица переживает вызовы prove, ведь
+// ключ записи включает цель и оставшиеся ходы сторон
+class ProofNumberSearch {
+public:
+  explicit ProofNumberSearch(size_t sizeMb = 4) : table_(sizeMb) {}
+
+  void setHashSizeMb(size_t sizeMb) { table_.resize(sizeMb); }
+  const ProofTable &table() const { return table_; }
+
+  // Достигает ли attacker цели goal с порогом target из позиции game, где
+  // на ходу player, при любой игре соперника. Unknown — не хватило
+  // maxNodes узлов или abort (он вызывается раз в 1024 узла) вернул true.
+  // bestMove — самый многообещающий ход player: при итоге в его пользу
+  // это доказывающий ход; Move(), если ходов нет
+  ProofResult prove(const GameState &game, char player, char attacker,
+                    ProofGoal goal, int target, uint64_t maxNodes,
+                    Move &bestMove, const std::function<bool()> &abort = {});
+  // Узлы последнего вызова prove
+  uint64_t nodes() const { return nodes_; }
+
+private:
+  // Границы счёта цели (фишки attacker в углу или перевес) при любой
+  // дальнейшей игре
+  void goalBounds(const Position &pos, int remainingBlackMoves,
+                  int remainingWhiteMoves, int &lower, int &upper) const;
+  // Узел решён, если цель достигнута при любой игре или недостижима
+  bool isTerminal(const Position &pos, int remainingBlackMoves,
+                  int remainingWhiteMoves, uint32_t &pn, uint32_t &dn) const;
+  // Числа узла из таблицы, для решённых узлов — без неё; новому узлу
+  // даются оценки по недостающим фишкам
+  void lookup(const Position &pos, char player, int remainingBlackMoves,
+              int remainingWhiteMoves, uint32_t &pn, uint32_t &dn,
+              uint16_t *move = nullptr) const;
+  uint64_t keyOf(const Position &pos, char player, int remainingBlackMoves,
+                 int remainingWhiteMoves) const;
+  // Раскрытие узла, пока его числа не дойдут до порогов
+  void mid(Position &pos, char player, int remainingBlackMoves,
+           int remainingWhiteMoves, uint32_t thresholdPn,
+           uint32_t thresholdDn);
+
+  ProofTable table_;
+  char attacker_ = 'B';
+  ProofGoal goal_ = ProofGoal::PiecesHome;
+  int target_ = 0;
+  uint64_t salt_ = 0;
+  uint64_t maxNodes_ = 0;
+  uint64_t nodes_ = 0;
+  bool aborted_ = false;
+  const std::function<bool()> *abort_ = nullptr;
+};
@@ -0,0 +1,76 @@
+#include "profile.h"
+
+#ifdef UGOLKI_PROFILE
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+const char *const kProbeNames[] = {"generateMoves", "isValidMove",
+                                   "evaluateBoard", "checkWin", "search"};
+static_assert(sizeof(kProbeNames) / sizeof(kProbeNames[0]) ==
+                  size_t(ProfileProbe::Count),
+              "name for every probe");
+
+// Буферы всех потоков. Поток регистрируется один раз, под мьютексом;
+// дальше пишет только в свой буфер. Буферы не освобождаются, чтобы
+// замеры завершившихся потоков попали в итог
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<profile::ThreadBuffer>> buffers;
+
+  ~Registry() { printProfile(stderr); }
+};
+
+Registry &registry() {
+  static Registry instance;
+  return instance;
+}
+} // namespace
+
+profile::ThreadBuffer &profile::threadBuffer() {
+  thread_local ThreadBuffer *buffer = [] {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.buffers.push_back(std::make_unique<ThreadBuffer>());
+    return r.buffers.back().get();
+  }();
+  return *buffer;
+}
+
+void printProfile(std::FILE *out) {
+  profile::Counter sum[int(ProfileProbe::Count)];
+  Registry &r = registry();
+  {
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto &buffer : r.buffers)
+      for (int i = 0; i < int(ProfileProbe::Count); ++i) {
+        sum[i].calls += buffer->counters[i].calls;
+        sum[i].selfNs += buffer->counters[i].selfNs;
+        sum[i].totalNs += buffer->counters[i].totalNs;
+      }
+  }
+  std::fprintf(out, "%-14s %14s %16s %10s %16s\n", "probe", "calls",
+               "self ns", "mean ns", "total ns");
+  for (int i = 0; i < int(ProfileProbe::Count); ++i)
+    std::fprintf(out, "%-14s %14llu %16llu %10.1f %16llu\n", kProbeNames[i],
+                 (unsigned long long)sum[i].calls,
+                 (unsigned long long)sum[i].selfNs,
+                 sum[i].calls ? double(sum[i].selfNs) / sum[i].calls : 0.0,
+                 (unsigned long long)sum[i].totalNs);
+}
+
+void resetProfile() {
+  Registry &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (const auto &buffer : r.buffers)
+    for (profile::Counter &c : buffer->counters)
+      c = profile::Counter();
+}
+
+void registerProfileThread() { profile::threadBuffer(); }
+#else
+void printProfile(std::FILE *) {}
+void resetProfile() {}
+void registerProfileThread() {}
+#endif
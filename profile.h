@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+
+// Пробы профилирования горячего пути движка. Собираются только с
+// UGOLKI_PROFILE (опция CMake того же имени); без него макрос
+// UGOLKI_PROFILE_SCOPE пуст и ничего не стоит
+enum class ProfileProbe : uint8_t {
+  GenerateMoves,
+  IsValidMove,
+  EvaluateBoard,
+  CheckWin,
+  Search,
+  Count
+};
+
+#ifdef UGOLKI_PROFILE
+#include <chrono>
+
+namespace profile {
+// Счётчики пробы в буфере одного потока. Собственное время — без
+// вложенных проб, полное — только у внешнего из рекурсивных вызовов
+struct Counter {
+  uint64_t calls = 0;
+  uint64_t selfNs = 0;
+  uint64_t totalNs = 0;
+};
+
+struct Scope;
+
+// Буфер потока: заводится при первом замере, живёт до конца программы
+struct ThreadBuffer {
+  Counter counters[int(ProfileProbe::Count)];
+  uint32_t active[int(ProfileProbe::Count)] = {};
+  Scope *top = nullptr;
+};
+
+ThreadBuffer &threadBuffer();
+
+// Замер от конструктора до деструктора
+struct Scope {
+  explicit Scope(ProfileProbe probe)
+      : buffer(threadBuffer()), probe(int(probe)), parent(buffer.top),
+        start(std::chrono::steady_clock::now()) {
+    buffer.top = this;
+    ++buffer.active[this->probe];
+  }
+  ~Scope() {
+    const uint64_t ns = uint64_t(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count());
+    Counter &c = buffer.counters[probe];
+    ++c.calls;
+    c.selfNs += ns - childNs;
+    if (--buffer.active[probe] == 0)
+      c.totalNs += ns;
+    if (parent)
+      parent->childNs += ns;
+    buffer.top = parent;
+  }
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+  ThreadBuffer &buffer;
+  int probe;
+  Scope *parent;
+  uint64_t childNs = 0;
+  std::chrono::steady_clock::time_point start;
+};
+} // namespace profile
+
+#define UGOLKI_PROFILE_SCOPE(probe)                                            \
+  profile::Scope profileScope_(ProfileProbe::probe)
+#else
+#define UGOLKI_PROFILE_SCOPE(probe) ((void)0)
+#endif
+
+// Плоский профиль по всем потокам: вызовы, собственное и полное время.
+// Печатается и при выходе из программы; без UGOLKI_PROFILE — ничего
+void printProfile(std::FILE *out);
+// Обнуляет счётчики всех потоков; вызывать, пока замеры не идут
+void resetProfile();
+// Заводит буфер вызывающего потока заранее, чтобы первый замер не
+// обращался к куче; без UGOLKI_PROFILE — ничего
+void registerProfileThread();
@@ -0,0 +1,406 @@
+#include "tablebase.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+// Заголовок файла таблиц; за ним подряд идут слои n = 0 .. 2 * maxCounter
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint32_t maxCounter;
+  uint32_t maxFree;
+  uint64_t layerSize;
+};
+static_assert(sizeof(Header) == 24, "заголовок пишется в файл как есть");
+
+constexpr char kMagic[4] = {'U', 'G', 'T', 'B'};
+constexpr uint32_t kVersion = 1;
+constexpr uint8_t kInvalid = 3;
+// Порция генерации: единица параллельной работы и отметки в журнале
+constexpr uint64_t kChunkSize = 1 << 14;
+
+constexpr int kTargetSize = pieces_per_side;
+constexpr int kOutsideSize = board_size * board_size - kTargetSize;
+
+struct Binomials {
+  uint64_t c[board_size * board_size + 1][kTablebaseMaxFree + 1] = {};
+  constexpr Binomials() {
+    for (int n = 0; n <= board_size * board_size; ++n) {
+      c[n][0] = 1;
+      for (int k = 1; k <= kTablebaseMaxFree; ++k)
+        c[n][k] = n == 0 ? 0 : c[n - 1][k - 1] + c[n - 1][k];
+    }
+  }
+};
+constexpr Binomials kBinomials;
+
+uint64_t binomial(int n, int k) { return kBinomials.c[n][k]; }
+
+// Нумерация клеток для ранжирования: клетки целевого угла стороны и клетки
+// вне его, по возрастанию; local — обратная таблица (-1, если клетки нет)
+struct SquareLists {
+  int target[2][kTargetSize];
+  int targetLocal[2][64];
+  int outside[2][kOutsideSize];
+  int outsideLocal[2][64];
+};
+
+SquareLists buildSquareLists() {
+  SquareLists lists;
+  for (int side = 0; side < 2; ++side) {
+    uint64_t target = targetSquares(side == 0 ? 'W' : 'B');
+    int inside = 0, outside = 0;
+    for (int sq = 0; sq < 64; ++sq) {
+      lists.targetLocal[side][sq] = lists.outsideLocal[side][sq] = -1;
+      if (target >> sq & 1) {
+        lists.targetLocal[side][sq] = inside;
+        lists.target[side][inside++] = sq;
+      } else {
+        lists.outsideLocal[side][sq] = outside;
+        lists.outside[side][outside++] = sq;
+      }
+    }
+  }
+  return lists;
+}
+
+const SquareLists &squareLists() {
+  static const SquareLists lists = buildSquareLists();
+  return lists;
+}
+
+// Класс таблиц: число свободных фишек белых и чёрных. Внутри класса ранг
+// складывается из четырёх сочетаний: пустые клетки угла белых, пустые
+// клетки угла чёрных, клетки свободных белых и свободных чёрных
+struct TablebaseClass {
+  int freeWhite, freeBlack;
+  uint64_t offset, size;
+};
+
+struct ClassTable {
+  std::vector<TablebaseClass> classes;
+  int index[kTablebaseMaxFree + 1][kTablebaseMaxFree + 1];
+  uint64_t layerSize = 0;
+};
+
+ClassTable buildClassTable() {
+  ClassTable table;
+  for (int fw = 0; fw <= kTablebaseMaxFree; ++fw)
+    for (int fb = 0; fb <= kTablebaseMaxFree; ++fb) {
+      table.index[fw][fb] = -1;
+      if (fw + fb > kTablebaseMaxFree)
+        continue;
+      TablebaseClass c;
+      c.freeWhite = fw;
+      c.freeBlack = fb;
+      c.offset = table.layerSize;
+      c.size = binomial(kTargetSize, fw) * binomial(kTargetSize, fb) *
+               binomial(kOutsideSize, fw) * binomial(kOutsideSize, fb);
+      table.index[fw][fb] = static_cast<int>(table.classes.size());
+      table.classes.push_back(c);
+      table.layerSize += c.size;
+    }
+  return table;
+}
+
+const ClassTable &classTable() {
+  static const ClassTable table = buildClassTable();
+  return table;
+}
+
+// Ранг сочетания в комбинаторной системе счисления: сумма C(local_i, i + 1)
+// по клеткам в порядке возрастания
+uint64_t rankSubset(uint64_t bits, const int *local) {
+  uint64_t rank = 0;
+  for (int i = 1; bits; bits &= bits - 1, ++i)
+    rank += binomial(local[lsb(bits)], i);
+  return rank;
+}
+
+uint64_t unrankSubset(uint64_t rank, int k, const int *squares) {
+  uint64_t bits = 0;
+  for (int i = k; i >= 1; --i) {
+    int c = i - 1;
+    while (binomial(c + 1, i) <= rank)
+      ++c;
+    rank -= binomial(c, i);
+    bits |= 1ULL << squares[c];
+  }
+  return bits;
+}
+
+// Расстановка по рангу внутри слоя; false для пересекающихся фишек
+bool decodeIndex(uint64_t index, Position &pos) {
+  const ClassTable &table = classTable();
+  const SquareLists &lists = squareLists();
+  const TablebaseClass *c = &table.classes[0];
+  for (const TablebaseClass &candidate : table.classes)
+    if (index >= candidate.offset && index < candidate.offset + candidate.size)
+      c = &candidate;
+  uint64_t rank = index - c->offset;
+  const int fw = c->freeWhite, fb = c->freeBlack;
+
+  uint64_t freeBlack = unrankSubset(rank % binomial(kOutsideSize, fb), fb,
+                                    lists.outside[1]);
+  rank /= binomial(kOutsideSize, fb);
+  uint64_t freeWhite = unrankSubset(rank % binomial(kOutsideSize, fw), fw,
+                                    lists.outside[0]);
+  rank /= binomial(kOutsideSize, fw);
+  uint64_t emptyBlack = unrankSubset(rank % binomial(kTargetSize, fb), fb,
+                                     lists.target[1]);
+  rank /= binomial(kTargetSize, fb);
+  uint64_t emptyWhite = unrankSubset(rank, fw, lists.target[0]);
+
+  const uint64_t lockedWhite = targetSquares('W') & ~emptyWhite;
+  const uint64_t lockedBlack = targetSquares('B') & ~emptyBlack;
+  pos.clear();
+  pos.white = lockedWhite | freeWhite;
+  pos.black = lockedBlack | freeBlack;
+  pos.locked = lockedWhite | lockedBlack;
+  pos.home[colourIndex('W')] = static_cast<uint8_t>(kTargetSize - fw);
+  pos.home[colourIndex('B')] = static_cast<uint8_t>(kTargetSize - fb);
+  return (pos.white & pos.black) == 0;
+}
+
+uint8_t packEntry(int wdl, int distance) {
+  return static_cast<uint8_t>((wdl + 1) | std::min(distance, 63) << 2);
+}
+
+// Итог позиции слоя plies по уже готовому слою plies - 1
+uint8_t solveEntry(uint64_t index, int plies, const uint8_t *previous) {
+  Position pos;
+  if (!decodeIndex(index, pos))
+    return kInvalid;
+  const int homeWhite = piecesHome(pos, 'W');
+  const int homeBlack = piecesHome(pos, 'B');
+  if (plies == 0) {
+    // партия окончена, «на ходу» белые
+    int diff = homeWhite - homeBlack;
+    return packEntry(diff > 0 ? 1 : diff < 0 ? -1 : 0, 0);
+  }
+
+  const char player = plies % 2 == 0 ? 'W' : 'B';
+  int best = -1, winDistance = 63, lossDistance = 0;
+  auto consider = [&](const Position &child) {
+    uint64_t childIndex = 0;
+    tablebaseIndex(child, childIndex);
+    uint8_t entry = previous[childIndex];
+    int wdl = 1 - (entry & 3); // итог соперника с обратным знаком
+    int distance = entry >> 2;
+    best = std::max(best, wdl);
+    if (wdl == 1)
+      winDistance = std::min(winDistance, distance);
+    lossDistance = std::max(lossDistance, distance);
+  };
+  MoveList moves;
+  generateMoves(pos, player, moves);
+  if (moves.empty()) {
+    consider(pos); // пропуск хода
+  } else {
+    for (Move m : moves) {
+      Position child = pos;
+      Undo undo;
+      makeMove(child, m, player, undo);
+      consider(child);
+    }
+  }
+  if (best == 0)
+    return packEntry(0, 0);
+
+  // Итог уже решён, если его не изменить оставшимися ходами
+  int lower, upper;
+  marginBounds(pos, 'B', (plies + 1) / 2, plies / 2, lower, upper);
+  if (lower > 0 || upper < 0)
+    return packEntry(best, 0);
+  return packEntry(best, 1 + (best == 1 ? winDistance : lossDistance));
+}
+} // namespace
+
+uint64_t tablebaseLayerSize() { return classTable().layerSize; }
+
+bool tablebaseIndex(const Position &pos, uint64_t &index) {
+  const uint64_t freeWhite = pos.white & ~pos.locked;
+  const uint64_t freeBlack = pos.black & ~pos.locked;
+  const int fw = popCount(freeWhite), fb = popCount(freeBlack);
+  if (fw + fb > kTablebaseMaxFree)
+    return false;
+  const uint64_t emptyWhite = targetSquares('W') & ~pos.white;
+  const uint64_t emptyBlack = targetSquares('B') & ~pos.black;
+  // таблицы рассчитаны на полный комплект фишек
+  if (popCount(emptyWhite) != fw || popCount(emptyBlack) != fb)
+    return false;
+
+  const ClassTable &table = classTable();
+  const SquareLists &lists = squareLists();
+  const TablebaseClass &c = table.classes[table.index[fw][fb]];
+  uint64_t rank = rankSubset(emptyWhite, lists.targetLocal[0]);
+  rank = rank * binomial(kTargetSize, fb) +
+         rankSubset(emptyBlack, lists.targetLocal[1]);
+  rank = rank * binomial(kOutsideSize, fw) +
+         rankSubset(freeWhite, lists.outsideLocal[0]);
+  rank = rank * binomial(kOutsideSize, fb) +
+         rankSubset(freeBlack, lists.outsideLocal[1]);
+  index = c.offset + rank;
+  return true;
+}
+
+bool Tablebase::open(const std::string &path) {
+  entries_ = nullptr;
+  if (!file_.open(path))
+    return false;
+  Header header;
+  if (file_.size() < sizeof(header)) {
+    file_.close();
+    return false;
+  }
+  std::memcpy(&header, file_.data(), sizeof(header));
+  const uint64_t layers = 2 * uint64_t(header.maxCounter) + 1;
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion || header.maxFree != kTablebaseMaxFree ||
+      header.layerSize != tablebaseLayerSize() ||
+      header.maxCounter > kTablebaseMaxCounter ||
+      file_.size() < sizeof(header) + layers * header.layerSize) {
+    file_.close();
+    return false;
+  }
+  entries_ = file_.data() + sizeof(header);
+  layerSize_ = header.layerSize;
+  maxCounter_ = static_cast<int>(header.maxCounter);
+  return true;
+}
+
+bool Tablebase::probe(const Position &pos, char player, int remainingBlackMoves,
+                      int remainingWhiteMoves, TablebaseResult &result) const {
+  if (!entries_)
+    return false;
+  // в таблицах только позиции строгого чередования: при равных счётчиках
+  // ходят белые, иначе у чёрных ровно на ход больше и ходят они
+  const int rb = remainingBlackMoves, rw = remainingWhiteMoves;
+  if (rw < 0 || rb > maxCounter_ || (rb != rw && rb != rw + 1) ||
+      player != (rb == rw ? 'W' : 'B'))
+    return false;
+  uint64_t index;
+  if (!tablebaseIndex(pos, index))
+    return false;
+  const uint8_t entry = entries_[uint64_t(rb + rw) * layerSize_ + index];
+  if ((entry & 3) == kInvalid)
+    return false;
+  result.wdl = (entry & 3) - 1;
+  result.distance = entry >> 2;
+  return true;
+}
+
+bool generateTablebase(const std::string &path, int maxCounter, int threads,
+                       int chunkLimit) {
+  maxCounter = std::max(1, std::min(maxCounter, kTablebaseMaxCounter));
+  threads = std::max(1, threads);
+  const uint64_t layerSize = tablebaseLayerSize();
+  const int layers = 2 * maxCounter + 1;
+  const uint64_t chunksPerLayer = (layerSize + kChunkSize - 1) / kChunkSize;
+  const std::string partPath = path + ".part", logPath = path + ".log";
+
+  Header header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.maxCounter = static_cast<uint32_t>(maxCounter);
+  header.maxFree = kTablebaseMaxFree;
+  header.layerSize = layerSize;
+
+  // Продолжение: незаконченный файл с тем же заголовком и журнал порций
+  std::vector<std::vector<bool>> done(layers,
+                                      std::vector<bool>(chunksPerLayer));
+  bool resume = false;
+  {
+    std::ifstream part(partPath, std::ios::binary);
+    Header existing;
+    if (part.read(reinterpret_cast<char *>(&existing), sizeof(existing)))
+      resume = std::memcmp(&existing, &header, sizeof(header)) == 0;
+  }
+  if (resume) {
+    std::ifstream log(logPath, std::ios::binary);
+    uint32_t record[2];
+    while (log.read(reinterpret_cast<char *>(record), sizeof(record)))
+      if (record[0] < uint32_t(layers) && record[1] < chunksPerLayer)
+        done[record[0]][record[1]] = true;
+  } else {
+    std::ofstream part(partPath, std::ios::binary | std::ios::trunc);
+    part.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    part.seekp(sizeof(header) + uint64_t(layers) * layerSize - 1);
+    part.put(0);
+    std::ofstream(logPath, std::ios::binary | std::ios::trunc);
+    if (!part)
+      return false;
+  }
+
+  std::fstream out(partPath, std::ios::binary | std::ios::in | std::ios::out);
+  std::ofstream log(logPath, std::ios::binary | std::ios::app);
+  if (!out || !log)
+    return false;
+
+  std::vector<uint8_t> previous(layerSize);
+  std::mutex ioMutex;
+  int processed = 0;
+  bool interrupted = false;
+  for (int plies = 0; plies < layers && !interrupted; ++plies) {
+    if (plies > 0) {
+      out.seekg(sizeof(header) + uint64_t(plies - 1) * layerSize);
+      out.read(reinterpret_cast<char *>(previous.data()), layerSize);
+    }
+    std::atomic<uint64_t> nextChunk{0};
+    auto work = [&] {
+      std::vector<uint8_t> buffer(kChunkSize);
+      for (;;) {
+        const uint64_t chunk = nextChunk.fetch_add(1);
+        if (chunk >= chunksPerLayer)
+          return;
+        if (done[plies][chunk])
+          continue;
+        {
+          std::lock_guard<std::mutex> guard(ioMutex);
+          if (interrupted || (chunkLimit > 0 && processed >= chunkLimit)) {
+            interrupted = true;
+            return;
+          }
+          ++processed;
+        }
+        const uint64_t begin = chunk * kChunkSize;
+        const uint64_t end = std::min(begin + kChunkSize, layerSize);
+        for (uint64_t i = begin; i < end; ++i)
+          buffer[i - begin] = solveEntry(i, plies, previous.data());
+
+        // сначала данные, потом отметка в журнале: оборванная запись
+        // порции просто посчитается заново
+        std::lock_guard<std::mutex> guard(ioMutex);
+        out.seekp(sizeof(header) + uint64_t(plies) * layerSize + begin);
+        out.write(reinterpret_cast<const char *>(buffer.data()), end - begin);
+        out.flush();
+        const uint32_t record[2] = {uint32_t(plies), uint32_t(chunk)};
+        log.write(reinterpret_cast<const char *>(record), sizeof(record));
+        log.flush();
+      }
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t)
+      pool.emplace_back(work);
+    work();
+    for (auto &t : pool)
+      t.join();
+  }
+  if (interrupted || !out || !log)
+    return false;
+
+  out.close();
+  log.close();
+  std::remove(path.c_str());
+  if (std::rename(partPath.c_str(), path.c_str()) != 0)
+    return false;
+  std::remove(logPath.c_str());
+  return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "ai.h"
+#include "mapped_file.h"
+
+// Таблицы эндшпиля для позиций, где почти все фишки уже заперты в углах:
+// свободных (не запертых) фишек у сторон вместе не больше
+// kTablebaseMaxFree. Для каждой такой расстановки и каждой пары счётчиков
+// оставшихся ходов хранится точный итог партии по правилам (больше фишек
+// в целевом углу после последнего хода) и расстояние до решённого итога.
+//
+// Ход строго чередуется, белые ходят первыми, поэтому счётчики задаются
+// числом оставшихся полуходов n: у чёрных (n + 1) / 2 ходов, у белых n / 2,
+// при чётном n ходят белые. Сторона без ходов пропускает ход, счётчик
+// при этом уменьшается.
+constexpr int kTablebaseMaxFree = 2;
+constexpr int kTablebaseMaxCounter = 20;
+
+// Итог с точки зрения стороны на ходу: wdl = 1 выигрыш, 0 ничья,
+// -1 проигрыш. distance — за сколько полуходов при лучшей игре итог
+// становится решённым (проигравшая сторона оттягивает, выигравшая
+// спешит); для ничьих 0
+struct TablebaseResult {
+  int wdl = 0;
+  int distance = 0;
+};
+
+// Ранг расстановки внутри слоя одного числа полуходов; false, если
+// позиция вне таблиц
+bool tablebaseIndex(const Position &pos, uint64_t &index);
+// Число записей в слое (одинаково для всех n)
+uint64_t tablebaseLayerSize();
+
+// Таблицы, отображённые в память. Запись — один байт: 2 бита итога
+// (0 проигрыш, 1 ничья, 2 выигрыш, 3 нет такой позиции) и 6 бит расстояния
+class Tablebase {
+public:
+  bool open(const std::string &path);
+  void close() { file_.close(); }
+  bool isOpen() const { return file_.isOpen(); }
+  // Наибольший счётчик ходов стороны, покрытый таблицами
+  int maxCounter() const { return maxCounter_; }
+
+  bool probe(const Position &pos, char player, int remainingBlackMoves,
+             int remainingWhiteMoves, TablebaseResult &result) const;
+
+private:
+  MappedFile file_;
+  const uint8_t *entries_ = nullptr;
+  uint64_t layerSize_ = 0;
+  int maxCounter_ = 0;
+};
+
+// Ретроградная генерация в файл path для счётчиков до maxCounter: слои
+// считаются от конца партии, внутри слоя — порциями в threads потоках.
+// Готовые порции отмечаются в журнале path + ".log", поэтому прерванная
+// генерация продолжается с места остановки. chunkLimit > 0 — остановиться
+// после стольких порций (для проверки продолжения). true, если таблицы
+// готовы
+bool generateTablebase(const std::string &path, int maxCounter, int threads,
+                       int chunkLimit = 0);
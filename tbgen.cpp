@@ -0,0 +1,39 @@
+/**
+ * @file tbgen.cpp
+ * @brief Генератор таблиц эндшпиля (без GUI).
+ *
+ * Считает таблицы ретроградным анализом во всех ядрах. Если генерацию
+ * прервать, повторный запуск с теми же параметрами продолжит её с места
+ * остановки.
+ *
+ * Запуск: tbgen [файл=ugolki.tb] [наибольший счётчик ходов=20] [потоки]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "tablebase.h"
+
+int main(int argc, char **argv) {
+  std::string path = argc > 1 ? argv[1] : "ugolki.tb";
+  int maxCounter = argc > 2 ? std::atoi(argv[2]) : kTablebaseMaxCounter;
+  int threads = argc > 3 ? std::atoi(argv[3])
+                         : static_cast<int>(std::thread::hardware_concurrency());
+
+  std::printf("%s: counters up to %d, %llu positions per layer, %d threads\n",
+              path.c_str(), maxCounter,
+              (unsigned long long)tablebaseLayerSize(), threads);
+  auto start = std::chrono::steady_clock::now();
+  if (!generateTablebase(path, maxCounter, threads)) {
+    std::fprintf(stderr, "generation failed; run again to resume\n");
+    return 1;
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  std::printf("done in %.1f s\n", seconds);
+  return 0;
+}
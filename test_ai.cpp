@@ -0,0 +1,1075 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "ai.h"
+#include "book.h"
+#include "mcts.h"
+#include "pns.h"
+#include "tablebase.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <tuple>
+
+static std::set<std::tuple<int, int, int, int>> allValidMoves(const Position &pos, char player) {
+    std::set<std::tuple<int, int, int, int>> result;
+    for (int x1 = 0; x1 < board_size; ++x1)
+        for (int y1 = 0; y1 < board_size; ++y1)
+            for (int x2 = 0; x2 < board_size; ++x2)
+                for (int y2 = 0; y2 < board_size; ++y2)
+                    if (isValidMove(pos, x1, y1, x2, y2, player))
+                        result.insert({x1, y1, x2, y2});
+    return result;
+}
+
+TEST_CASE("start position is balanced") {
+    Position pos = startPosition();
+    CHECK(evaluateBoard(pos, 20, 20) == 0);
+    CHECK_FALSE(checkWin(pos, 'W'));
+    CHECK_FALSE(checkWin(pos, 'B'));
+}
+
+// Оценка прямым обходом доски, как до таблиц «фишка-клетка»
+static int referenceEvaluation(const Position &pos, int remainingBlackMoves, int remainingWhiteMoves) {
+    int score = 0;
+    for (int x = 0; x < board_size; ++x)
+        for (int y = 0; y < board_size; ++y) {
+            if (pos.at(x, y) == 'B') {
+                score -= distanceToCorner(x, y, 'B') * 10;
+                if (x + y <= corner_size - 1)
+                    score += 50;
+            } else if (pos.at(x, y) == 'W') {
+                score += distanceToCorner(x, y, 'W') * 10;
+                if (x + y >= 2 * board_size - corner_size - 1)
+                    score -= 50;
+            }
+            if (x + y <= corner_size - 1 && pos.at(x, y) != 'B' && remainingBlackMoves <= 5)
+                score -= 20;
+            if (x + y >= 2 * board_size - corner_size - 1 && pos.at(x, y) != 'W' && remainingWhiteMoves <= 5)
+                score += 20;
+        }
+    return score;
+}
+
+TEST_CASE("evaluateBoard matches a full board scan") {
+    Position pos;
+    pos.set(0, 0, 'B');
+    pos.set(2, 1, 'B');
+    pos.set(4, 4, 'B');
+    pos.set(7, 7, 'W');
+    pos.set(5, 6, 'W');
+    pos.set(1, 1, 'W');
+    for (int remaining : {20, 5, 1})
+        CHECK(evaluateBoard(pos, remaining, remaining) == referenceEvaluation(pos, remaining, remaining));
+}
+
+TEST_CASE("generateMoves agrees with isValidMove") {
+    Position pos = startPosition();
+    // несколько ходов, чтобы фишки перемешались и появились прыжки
+    REQUIRE(makeMove(pos, 3, 0, 4, 0, 'W'));
+    REQUIRE(makeMove(pos, 7, 4, 6, 4, 'B'));
+    REQUIRE(makeMove(pos, 2, 1, 3, 1, 'W'));
+    REQUIRE(makeMove(pos, 6, 5, 6, 3, 'B'));
+
+    for (char player : {'W', 'B'}) {
+        std::set<std::tuple<int, int, int, int>> generated;
+        for (const Move &m : generateMoves(pos, player))
+            CHECK(generated.insert({m.x1(), m.y1(), m.x2(), m.y2()}).second);
+        CHECK(generated == allValidMoves(pos, player));
+    }
+}
+
+TEST_CASE("chained jumps give one move per reachable square") {
+    Position pos;
+    pos.set(0, 0, 'W');
+    pos.set(1, 0, 'B'); // (0,0) -> (2,0)
+    pos.set(3, 0, 'W'); // (2,0) -> (4,0)
+    pos.set(2, 1, 'B'); // (2,0) -> (2,2)
+    pos.set(3, 2, 'B'); // (2,2) -> (4,2)
+    pos.set(4, 1, 'W'); // (4,0) -> (4,2): та же клетка вторым путём
+
+    std::set<std::pair<int, int>> targets;
+    for (const Move &m : generateMoves(pos, 'W'))
+        if (m.x1() == 0 && m.y1() == 0)
+            CHECK(targets.insert({m.x2(), m.y2()}).second);
+    const std::set<std::pair<int, int>> expected = {
+        {0, 1}, {2, 0}, {4, 0}, {2, 2}, {4, 2}};
+    CHECK(targets == expected);
+
+    CHECK(isValidMove(pos, 0, 0, 4, 2, 'W'));
+    CHECK_FALSE(isValidMove(pos, 0, 0, 2, 4, 'W'));
+    REQUIRE(makeMove(pos, 0, 0, 4, 2, 'W'));
+    CHECK(pos.at(4, 2) == 'W');
+    CHECK(pos.at(0, 0) == '.');
+}
+
+TEST_CASE("unmakeMove restores the position after every move") {
+    Position pos;
+    pos.set(1, 3, 'B'); // ходы в угол запирают эту фишку
+    pos.set(1, 2, 'W');
+    pos.set(4, 4, 'W');
+    pos.set(4, 5, 'B');
+
+    for (char player : {'W', 'B'}) {
+        Position before = pos;
+        for (const Move &m : generateMoves(pos, player)) {
+            Undo undo;
+            makeMove(pos, m, player, undo);
+            CHECK(pos.at(m.x2(), m.y2()) == player);
+            CHECK(pos.at(m.x1(), m.y1()) == '.');
+            unmakeMove(pos, undo, player);
+            CHECK(pos.white == before.white);
+            CHECK(pos.black == before.black);
+            CHECK(pos.locked == before.locked);
+            CHECK(pos.key == before.key);
+            CHECK(pos.score == before.score);
+            CHECK(piecesHome(pos, player) == piecesHome(before, player));
+        }
+    }
+}
+
+TEST_CASE("incremental key and score match ones built from scratch") {
+    Position pos = startPosition();
+    REQUIRE(makeMove(pos, 3, 0, 4, 0, 'W'));
+    REQUIRE(makeMove(pos, 7, 4, 6, 4, 'B'));
+    REQUIRE(makeMove(pos, 2, 1, 3, 1, 'W'));
+    REQUIRE(makeMove(pos, 6, 5, 6, 3, 'B'));
+
+    Position rebuilt;
+    for (int x = 0; x < board_size; ++x)
+        for (int y = 0; y < board_size; ++y)
+            rebuilt.set(x, y, pos.at(x, y));
+    CHECK(pos.key == rebuilt.key);
+    CHECK(pos.score == rebuilt.score);
+    CHECK(piecesHome(pos, 'W') == piecesHome(rebuilt, 'W'));
+    CHECK(piecesHome(pos, 'B') == piecesHome(rebuilt, 'B'));
+    CHECK(pos.key != startPosition().key);
+
+    // сторона на ходу и счётчики ходов входят в ключ узла
+    CHECK(positionKey(pos, 'W', 18, 18) != positionKey(pos, 'B', 18, 18));
+    CHECK(positionKey(pos, 'W', 18, 18) != positionKey(pos, 'W', 18, 17));
+}
+
+TEST_CASE("transposition table keeps the deepest result for a position") {
+    TranspositionTable tt(1);
+    const uint64_t key = 0x123456789ABCDEF0ULL;
+    TTHit hit;
+    CHECK_FALSE(tt.probe(key, hit));
+
+    tt.store(key, 5, Bound::Exact, -1234, 0x0ABC);
+    REQUIRE(tt.probe(key, hit));
+    CHECK(hit.depth == 5);
+    CHECK(hit.bound == Bound::Exact);
+    CHECK(hit.score == -1234);
+    CHECK(hit.move == 0x0ABC);
+
+    tt.store(key, 3, Bound::Lower, 99, 0);
+    REQUIRE(tt.probe(key, hit));
+    CHECK(hit.depth == 5);
+
+    CHECK_FALSE(tt.probe(key ^ 1, hit));
+    tt.clear();
+    CHECK_FALSE(tt.probe(key, hit));
+}
+
+TEST_CASE("pieces of both colours are locked in their target corner") {
+    Position pos;
+    pos.set(0, 4, 'B');
+    pos.set(7, 3, 'W');
+    REQUIRE(makeMove(pos, 0, 4, 0, 3, 'B'));
+    REQUIRE(makeMove(pos, 7, 3, 7, 4, 'W'));
+    CHECK_FALSE(isValidMove(pos, 0, 3, 0, 4, 'B'));
+    CHECK_FALSE(isValidMove(pos, 7, 4, 7, 3, 'W'));
+    CHECK(piecesHome(pos, 'B') == 1);
+    CHECK(piecesHome(pos, 'W') == 1);
+    CHECK(generateMoves(pos, 'B').empty());
+    CHECK(generateMoves(pos, 'W').empty());
+}
+
+TEST_CASE("checkWin needs six pieces in the target triangle") {
+    Position pos;
+    const int cells[6][2] = {{0, 0}, {0, 1}, {1, 0}, {0, 2}, {1, 1}, {2, 0}};
+    for (int i = 0; i < 5; ++i)
+        pos.set(cells[i][0], cells[i][1], 'B');
+    CHECK_FALSE(checkWin(pos, 'B'));
+    CHECK(piecesHome(pos, 'B') == 5);
+    pos.set(cells[5][0], cells[5][1], 'B');
+    CHECK(checkWin(pos, 'B'));
+    CHECK_FALSE(checkWin(pos, 'W'));
+    // фишка вне угла и снятая фишка счётчик не увеличивают
+    pos.set(3, 3, 'B');
+    pos.set(cells[0][0], cells[0][1], '.');
+    CHECK(piecesHome(pos, 'B') == 5);
+}
+
+TEST_CASE("two engines play a whole game against each other") {
+    GameState game;
+    game.board = startPosition();
+    Engine white, black;
+    SearchLimits limits;
+    limits.maxDepth = 2;
+    white.setLimits(limits);
+    black.setLimits(limits);
+    while (game.whiteMoves > 0 || game.blackMoves > 0) {
+        // при отсутствии ходов сторона пропускает ход, но лимит тратится
+        if (game.whiteMoves > 0 && !white.makeAIMove(game, 'W'))
+            CHECK(passTurn(game, 'W'));
+        if (game.blackMoves > 0 && !black.makeAIMove(game, 'B'))
+            CHECK(passTurn(game, 'B'));
+    }
+    CHECK(game.moveNumber == 40);
+    CHECK(game.moveHistory.size() == 40);
+    CHECK(popCount(game.board.white) == 10);
+    CHECK(popCount(game.board.black) == 10);
+}
+
+TEST_CASE("iterative deepening stops at the depth limit and the game horizon") {
+    GameState game;
+    game.board = startPosition();
+    Engine engine;
+    SearchLimits limits;
+    limits.maxDepth = 3;
+    limits.softTimeMs = limits.hardTimeMs = 60000;
+    engine.setLimits(limits);
+
+    Move best;
+    REQUIRE(engine.findBestMove(game, 'W', best));
+    CHECK(engine.completedDepth() == 3);
+    CHECK(isValidMove(game.board, best.x1(), best.y1(), best.x2(), best.y2(), 'W'));
+
+    // последний ход партии: дальше одного полухода искать нечего
+    game.whiteMoves = 0;
+    game.blackMoves = 1;
+    REQUIRE(engine.findBestMove(game, 'B', best));
+    CHECK(engine.completedDepth() == 1);
+}
+
+TEST_CASE("search always returns a move even when the deadline has passed") {
+    GameState game;
+    game.board = startPosition();
+    Engine engine;
+    SearchLimits limits;
+    limits.softTimeMs = limits.hardTimeMs = 0;
+    engine.setLimits(limits);
+
+    Move best;
+    REQUIRE(engine.findBestMove(game, 'B', best));
+    CHECK(isValidMove(game.board, best.x1(), best.y1(), best.x2(), best.y2(), 'B'));
+}
+
+TEST_CASE("search statistics are consistent for one and several threads") {
+    GameState game;
+    game.board = startPosition();
+    SearchLimits limits;
+    limits.maxDepth = 5;
+    limits.softTimeMs = limits.hardTimeMs = 60000;
+    for (int threads : {1, 4}) {
+        Engine engine;
+        engine.setLimits(limits);
+        engine.setThreads(threads);
+        Move best;
+        REQUIRE(engine.findBestMove(game, 'W', best));
+        const SearchStats &stats = engine.stats();
+        CHECK(stats.depth == engine.completedDepth());
+        CHECK(stats.selDepth >= stats.depth);
+        CHECK(stats.leafEvals > 0);
+        CHECK(stats.leafEvals <= stats.nodes);
+        CHECK(stats.ttCutoffs <= stats.ttHits);
+        CHECK(stats.ttHits <= stats.ttProbes);
+        CHECK(stats.firstMoveCutoffs <= stats.cutoffs);
+        CHECK(stats.firstMoveCutoffRate() <= 1.0);
+        CHECK(stats.timeMs > 0);
+        CHECK(stats.nodesPerSecond() > 0);
+
+        // итерации главного потока: время и узлы растут с глубиной
+        REQUIRE(stats.iterations >= 2);
+        if (threads == 1)
+            CHECK(stats.iterations == stats.depth);
+        for (int i = 1; i < stats.iterations; ++i) {
+            CHECK(stats.iterationMs[i] >= stats.iterationMs[i - 1]);
+            CHECK(stats.iterationNodes[i] >= stats.iterationNodes[i - 1]);
+        }
+        CHECK(stats.iterationNodes[stats.iterations - 1] <= stats.nodes);
+        CHECK(stats.effectiveBranchingFactor() >= 1.0);
+    }
+
+    SearchStats a, b;
+    a.nodes = 10;
+    a.selDepth = 7;
+    b.nodes = 5;
+    b.ttHits = 3;
+    b.selDepth = 9;
+    a.merge(b);
+    CHECK(a.nodes == 15);
+    CHECK(a.ttHits == 3);
+    CHECK(a.selDepth == 9);
+}
+
+TEST_CASE("hardware counters are optional and summed over threads") {
+    HardwareCounters a, b;
+    a.cycles = 100;
+    a.instructions = 250;
+    b.cycles = 100;
+    b.instructions = 50;
+    b.valid = true;
+    a.merge(b);
+    CHECK(a.valid);
+    CHECK(a.ipc() == doctest::Approx(1.5));
+    CHECK(HardwareCounters().ipc() == 0.0);
+
+    // без PMU или разрешений поиск идёт как обычно, счётчики пустые
+    GameState game;
+    game.board = startPosition();
+    Engine engine;
+    SearchLimits limits;
+    limits.maxDepth = 4;
+    limits.softTimeMs = limits.hardTimeMs = 60000;
+    engine.setLimits(limits);
+    engine.setThreads(2);
+    engine.setHardwareCounters(true);
+    Move best;
+    REQUIRE(engine.findBestMove(game, 'W', best));
+    CHECK(engine.completedDepth() == 4);
+    const HardwareCounters &hw = engine.stats().hardware;
+    if (hw.valid)
+        CHECK(hw.cycles > 0);
+    else
+        CHECK(hw.instructions == 0);
+}
+
+namespace {
+// Полный перебор без отсечений и таблицы: эталон для упорядоченного поиска
+int plainMinimax(Position &pos, int depth, bool isMaximizing, int rb, int rw) {
+    int remaining = isMaximizing ? rb : rw;
+    if (depth == 0 || remaining <= 0 || checkWin(pos, 'B') || checkWin(pos, 'W'))
+        return evaluateBoard(pos, rb, rw);
+    char player = isMaximizing ? 'B' : 'W';
+    MoveList moves = generateMoves(pos, player);
+    if (moves.empty())
+        return evaluateBoard(pos, rb, rw);
+    int best = isMaximizing ? -1000000 : 1000000;
+    for (Move m : moves) {
+        Undo undo;
+        makeMove(pos, m, player, undo);
+        int eval = isMaximizing ? plainMinimax(pos, depth - 1, false, rb - 1, rw)
+                                : plainMinimax(pos, depth - 1, true, rb, rw - 1);
+        unmakeMove(pos, undo, player);
+        best = isMaximizing ? std::max(best, eval) : std::min(best, eval);
+    }
+    return best;
+}
+} // namespace
+
+TEST_CASE("text position round-trips through parsePosition") {
+    GameState game;
+    game.board = startPosition();
+    game.whiteMoves = 17;
+    game.blackMoves = 16;
+    std::string text = positionToString(game, 'B');
+
+    GameState parsed;
+    char side = 0;
+    REQUIRE(parsePosition(text, parsed, side));
+    CHECK(side == 'B');
+    CHECK(parsed.whiteMoves == 17);
+    CHECK(parsed.blackMoves == 16);
+    CHECK(parsed.board.white == game.board.white);
+    CHECK(parsed.board.black == game.board.black);
+    CHECK(parsed.board.key == game.board.key);
+    CHECK(positionToString(parsed, side) == text);
+    CHECK_FALSE(parsePosition("WWWW/.... W 20 20", parsed, side));
+}
+
+TEST_CASE("move ordering does not change the search value") {
+    Position pos = startPosition();
+    // несколько ходов, чтобы появились прыжки и тихие ходы обеих сторон
+    REQUIRE(makeMove(pos, 3, 0, 4, 0, 'W'));
+    REQUIRE(makeMove(pos, 4, 7, 3, 7, 'B'));
+    REQUIRE(makeMove(pos, 2, 1, 2, 2, 'W'));
+
+    Engine engine;
+    for (int depth = 1; depth <= 3; ++depth) {
+        Position copy = pos;
+        int expected = plainMinimax(copy, depth, true, 19, 18);
+        CHECK(engine.minimax(pos, depth, true, -1000000, 1000000, 19, 18) == expected);
+        CHECK(pos.key == copy.key);
+    }
+}
+
+TEST_CASE("principal variation is a legal line that starts with the best move") {
+    GameState game;
+    game.board = startPosition();
+    REQUIRE(makeMove(game.board, 3, 0, 4, 0, 'W'));
+    game.whiteMoves = 19;
+
+    Engine engine;
+    SearchLimits limits;
+    limits.maxDepth = 4;
+    limits.softTimeMs = limits.hardTimeMs = 60000;
+    engine.setLimits(limits);
+    Move best;
+    REQUIRE(engine.findBestMove(game, 'B', best));
+
+    std::vector<Move> pv = engine.principalVariation();
+    REQUIRE(!pv.empty());
+    CHECK(pv.size() <= 4);
+    CHECK(pv[0] == best);
+    Position pos = game.board;
+    char player = 'B';
+    for (Move m : pv) {
+        CHECK(makeMove(pos, m.x1(), m.y1(), m.x2(), m.y2(), player));
+        player = player == 'B' ? 'W' : 'B';
+    }
+
+    // оценка с аспирацией совпадает с полным перебором той же глубины
+    Position copy = game.board;
+    CHECK(engine.score() == plainMinimax(copy, 4, true, 20, 19));
+}
+
+TEST_CASE("lazy SMP search returns a legal line from any thread count") {
+    GameState game;
+    game.board = startPosition();
+    REQUIRE(makeMove(game.board, 3, 0, 4, 0, 'W'));
+    game.whiteMoves = 19;
+
+    SearchLimits limits;
+    limits.maxDepth = 5;
+    limits.softTimeMs = limits.hardTimeMs = 60000;
+    for (int threads : {1, 2, 4}) {
+        Engine engine;
+        engine.setLimits(limits);
+        engine.setThreads(threads);
+        CHECK(engine.threads() == threads);
+        Move best;
+        REQUIRE(engine.findBestMove(game, 'B', best));
+        CHECK(engine.completedDepth() >= 5);
+
+        const std::vector<Move> &pv = engine.principalVariation();
+        REQUIRE(!pv.empty());
+        CHECK(pv[0] == best);
+        Position pos = game.board;
+        char player = 'B';
+        for (Move m : pv) {
+            CHECK(makeMove(pos, m.x1(), m.y1(), m.x2(), m.y2(), player));
+            player = player == 'B' ? 'W' : 'B';
+        }
+    }
+}
+
+TEST_CASE("YBWC search finds the same value as the serial search") {
+    GameState game;
+    game.board = startPosition();
+    REQUIRE(makeMove(game.board, 3, 0, 4, 0, 'W'));
+    REQUIRE(makeMove(game.board, 4, 7, 3, 7, 'B'));
+    REQUIRE(makeMove(game.board, 2, 1, 2, 2, 'W'));
+    game.whiteMoves = 18;
+    game.blackMoves = 19;
+
+    SearchLimits limits;
+    limits.maxDepth = 4;
+    limits.softTimeMs = limits.hardTimeMs = 60000;
+    Position copy = game.board;
+    const int expected = plainMinimax(copy, 4, true, 19, 18);
+    for (int threads : {1, 3}) {
+        Engine engine;
+        engine.setLimits(limits);
+        engine.setThreads(threads);
+        engine.setParallelMode(ParallelMode::Ybwc);
+        Move best;
+        REQUIRE(engine.findBestMove(game, 'B', best));
+        CHECK(engine.completedDepth() == 4);
+        CHECK(engine.score() == expected);
+        CHECK(isValidMove(game.board, best.x1(), best.y1(), best.x2(), best.y2(), 'B'));
+    }
+}
+
+TEST_CASE("pondering continues on a hit and stops quickly on a miss") {
+    GameState game;
+    game.board = startPosition();
+    REQUIRE(makeMove(game.board, 3, 0, 4, 0, 'W'));
+    game.whiteMoves = 19;
+
+    Engine engine;
+    SearchLimits limits;
+    limits.softTimeMs = 50;
+    limits.hardTimeMs = 100;
+    engine.setLimits(limits);
+    REQUIRE(engine.makeAIMove(game, 'B'));
+    CHECK_FALSE(engine.isPondering());
+
+    // попадание: белые играют предсказанный ход
+    GameState hit = game;
+    REQUIRE(engine.startPondering(hit, 'W'));
+    CHECK(engine.isPondering());
+    Move predicted = engine.ponderMove();
+    REQUIRE(makeMove(hit.board, predicted.x1(), predicted.y1(), predicted.x2(),
+                     predicted.y2(), 'W'));
+    hit.whiteMoves--;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Move best;
+    REQUIRE(engine.findBestMove(hit, 'B', best));
+    CHECK(engine.ponderHits() == 1);
+    CHECK_FALSE(engine.isPondering());
+    CHECK(isValidMove(hit.board, best.x1(), best.y1(), best.x2(), best.y2(), 'B'));
+
+    // промах: любой другой ход белых прерывает размышление
+    REQUIRE(makeMove(hit.board, best.x1(), best.y1(), best.x2(), best.y2(), 'B'));
+    hit.blackMoves--;
+    REQUIRE(engine.startPondering(hit, 'W'));
+    predicted = engine.ponderMove();
+    MoveList replies = generateMoves(hit.board, 'W');
+    Move other = replies[0] == predicted ? replies[1] : replies[0];
+    REQUIRE(makeMove(hit.board, other.x1(), other.y1(), other.x2(), other.y2(), 'W'));
+    hit.whiteMoves--;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(engine.findBestMove(hit, 'B', best));
+    CHECK(engine.ponderHits() == 1);
+    CHECK(isValidMove(hit.board, best.x1(), best.y1(), best.x2(), best.y2(), 'B'));
+
+    // остановка размышления не ждёт конца итерации
+    REQUIRE(makeMove(hit.board, best.x1(), best.y1(), best.x2(), best.y2(), 'B'));
+    hit.blackMoves--;
+    REQUIRE(engine.startPondering(hit, 'W'));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto start = std::chrono::steady_clock::now();
+    engine.stopPondering();
+    auto stopped = std::chrono::steady_clock::now() - start;
+    // запас на медленные машины; на практике это доли миллисекунды
+    CHECK(stopped < std::chrono::milliseconds(20));
+    CHECK_FALSE(engine.isPondering());
+}
+
+TEST_CASE("minimax stops pondering before it searches") {
+    GameState game;
+    game.board = startPosition();
+    Engine engine;
+    SearchLimits limits;
+    limits.maxDepth = 4;
+    limits.softTimeMs = limits.hardTimeMs = 60000;
+    engine.setLimits(limits);
+    Move best;
+    REQUIRE(engine.findBestMove(game, 'W', best));
+    REQUIRE(makeMove(game.board, best.x1(), best.y1(), best.x2(), best.y2(), 'W'));
+    game.whiteMoves--;
+    REQUIRE(engine.startPondering(game, 'B'));
+
+    Position pos = game.board;
+    engine.minimax(pos, 3, true, -1000000, 1000000, 20, 19);
+    CHECK_FALSE(engine.isPondering());
+    CHECK(pos.key == game.board.key);
+    // движок снова готов к обычному ходу
+    REQUIRE(engine.findBestMove(game, 'B', best));
+    CHECK(isValidMove(game.board, best.x1(), best.y1(), best.x2(), best.y2(), 'B'));
+}
+
+namespace {
+// Итог по правилам полным перебором: разность фишек в углах у стороны на
+// ходу и у соперника при лучшей игре обеих сторон
+int trueMargin(Position &pos, char player, int rb, int rw) {
+    char opponent = player == 'B' ? 'W' : 'B';
+    if (rb == 0 && rw == 0)
+        return piecesHome(pos, player) - piecesHome(pos, opponent);
+    if ((player == 'B' ? rb : rw) == 0)
+        return -trueMargin(pos, opponent, rb, rw);
+    int childBlack = rb - (player == 'B' ? 1 : 0);
+    int childWhite = rw - (player == 'W' ? 1 : 0);
+    MoveList moves = generateMoves(pos, player);
+    if (moves.empty())
+        return -trueMargin(pos, opponent, childBlack, childWhite);
+    int best = -pieces_per_side;
+    for (Move m : moves) {
+        Undo undo;
+        makeMove(pos, m, player, undo);
+        best = std::max(best, -trueMargin(pos, opponent, childBlack, childWhite));
+        unmakeMove(pos, undo, player);
+    }
+    return best;
+}
+
+// Почти законченная партия: у сторон свободно freeWhite и freeBlack фишек,
+// остальные заперты в своих углах на случайных клетках
+Position lateRacePosition(std::mt19937 &rng, int freeWhite, int freeBlack) {
+    Position pos;
+    pos.clear();
+    for (char player : {'W', 'B'}) {
+        std::vector<int> target;
+        for (int sq = 0; sq < 64; ++sq)
+            if (targetSquares(player) >> sq & 1)
+                target.push_back(sq);
+        std::shuffle(target.begin(), target.end(), rng);
+        int free = player == 'W' ? freeWhite : freeBlack;
+        for (int i = free; i < pieces_per_side; ++i)
+            pos.set(target[i] / board_size, target[i] % board_size, player);
+    }
+    for (char player : {'W', 'B'}) {
+        int free = player == 'W' ? freeWhite : freeBlack;
+        while (free > 0) {
+            int sq = int(rng() % 64);
+            if ((targetSquares(player) >> sq & 1) || (pos.occupied() >> sq & 1))
+                continue;
+            pos.set(sq / board_size, sq % board_size, player);
+            --free;
+        }
+    }
+    return pos;
+}
+
+int outcome(int margin) { return margin > 0 ? 1 : margin < 0 ? -1 : 0; }
+
+// Случайная гонка для сверки с полным перебором: lateRacePosition и
+// счётчики на plies полуходов до конца партии (minPlies..maxPlies),
+// последний полуход — белых
+struct LateRace {
+    GameState game;
+    char player;
+    int plies;
+
+    // Итог при лучшей игре для стороны на ходу: сразу и после её хода m
+    int margin() const {
+        Position pos = game.board;
+        return trueMargin(pos, player, game.blackMoves, game.whiteMoves);
+    }
+    int marginAfter(Move m) const {
+        Position pos = game.board;
+        Undo undo;
+        makeMove(pos, m, player, undo);
+        return -trueMargin(pos, player == 'B' ? 'W' : 'B', game.blackMoves - (player == 'B'),
+                           game.whiteMoves - (player == 'W'));
+    }
+};
+
+LateRace lateRace(std::mt19937 &rng, int freeWhite, int freeBlack, int minPlies, int maxPlies) {
+    LateRace race;
+    race.game.board = lateRacePosition(rng, freeWhite, freeBlack);
+    race.plies = minPlies + (maxPlies > minPlies ? int(rng() % (maxPlies - minPlies + 1)) : 0);
+    race.game.blackMoves = (race.plies + 1) / 2;
+    race.game.whiteMoves = race.plies / 2;
+    race.player = race.plies % 2 == 0 ? 'W' : 'B';
+    return race;
+}
+
+std::string readFile(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+} // namespace
+
+TEST_CASE("endgame tablebase matches exhaustive play and resumes generation") {
+    const std::string path = "test_ai_tablebase.tb";
+    const std::string fresh = "test_ai_tablebase_fresh.tb";
+    // прерванная генерация продолжается и даёт тот же файл, что и сразу
+    CHECK_FALSE(generateTablebase(path, 2, 2, 10));
+    REQUIRE(generateTablebase(path, 2, 2));
+    REQUIRE(generateTablebase(fresh, 2, 1));
+    CHECK(readFile(path) == readFile(fresh));
+    std::remove(fresh.c_str());
+
+    Tablebase tablebase;
+    REQUIRE(tablebase.open(path));
+    CHECK(tablebase.maxCounter() == 2);
+
+    std::mt19937 rng(7);
+    int decisive = 0;
+    for (int trial = 0; trial < 300; ++trial) {
+        int freeWhite = int(rng() % 3);
+        int freeBlack = int(rng() % (3 - freeWhite));
+        LateRace race = lateRace(rng, freeWhite, freeBlack, 0, 4);
+
+        TablebaseResult result;
+        REQUIRE(tablebase.probe(race.game.board, race.player, race.game.blackMoves,
+                                race.game.whiteMoves, result));
+        CHECK(result.wdl == outcome(race.margin()));
+        CHECK(result.distance <= race.plies);
+        if (result.wdl != 0)
+            ++decisive;
+    }
+    CHECK(decisive > 0);
+
+    // вне таблиц: много свободных фишек или счётчики не по очереди ходов
+    TablebaseResult result;
+    CHECK_FALSE(tablebase.probe(startPosition(), 'W', 2, 2, result));
+    Position pos = lateRacePosition(rng, 1, 1);
+    CHECK_FALSE(tablebase.probe(pos, 'B', 2, 2, result));
+    CHECK_FALSE(tablebase.probe(pos, 'W', 3, 3, result));
+
+    // поиск с таблицами выбирает ход с лучшим итогом
+    for (int trial = 0; trial < 20; ++trial) {
+        LateRace race = lateRace(rng, 1, 1, 3, 3);
+        Engine engine;
+        engine.setTablebase(&tablebase);
+        Move best;
+        REQUIRE(engine.findBestMove(race.game, race.player, best));
+        CHECK(outcome(race.marginAfter(best)) == outcome(race.margin()));
+    }
+    tablebase.close();
+    std::remove(path.c_str());
+}
+
+TEST_CASE("opening book is sorted and drives the first moves") {
+    const std::string path = "test_ai_opening.book";
+    BookBuildOptions options;
+    options.plies = 2;
+    options.depth = 2;
+    options.games = 8;
+    options.threads = 2;
+    REQUIRE(buildOpeningBook(path, options));
+
+    OpeningBook book;
+    REQUIRE(book.open(path));
+    REQUIRE(book.size() > 0);
+    const uint64_t start = positionKey(startPosition(), 'W', 20, 20);
+    const BookEntry *first, *last;
+    book.find(start, first, last);
+    REQUIRE(first != last);
+    CHECK(last - first <= options.maxCandidates);
+    for (const BookEntry *e = first; e != last; ++e) {
+        Move m(e->move);
+        CHECK(isValidMove(startPosition(), m.x1(), m.y1(), m.x2(), m.y2(), 'W'));
+        CHECK(e->weight > 0);
+    }
+    // позиции вне книги не находятся
+    book.find(positionKey(startPosition(), 'B', 20, 20), first, last);
+    CHECK(first == last);
+
+    // ход из книги делается без поиска и остаётся в книге
+    GameState game;
+    game.board = startPosition();
+    Engine engine;
+    engine.setBook(&book);
+    engine.setRandomSeed(3);
+    REQUIRE(engine.makeAIMove(game, 'W'));
+    CHECK(engine.nodes() == 0);
+    CHECK(engine.principalVariation().size() == 1);
+    CHECK(game.whiteMoves == 19);
+    Move played = engine.principalVariation()[0];
+    book.find(start, first, last);
+    CHECK(std::any_of(first, last, [&](const BookEntry &e) { return e.move == played.data; }));
+    // за книгой движок снова ищет
+    REQUIRE(engine.makeAIMove(game, 'B'));
+    REQUIRE(engine.makeAIMove(game, 'W'));
+    CHECK(engine.nodes() > 0);
+
+    book.close();
+    // счётчик записей, при умножении на размер записи дающий ноль, не
+    // выводит за конец файла
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        const char header[16] = {'U', 'G', 'O', 'B', 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x10};
+        out.write(header, sizeof(header));
+    }
+    CHECK_FALSE(book.open(path));
+    std::remove(path.c_str());
+}
+
+TEST_CASE("exact solver plays late positions perfectly within its budget") {
+    std::mt19937 rng(11);
+    int decisive = 0;
+    for (int trial = 0; trial < 30; ++trial) {
+        int freeWhite = 1 + int(rng() % 2), freeBlack = 1 + int(rng() % 2);
+        LateRace race = lateRace(rng, freeWhite, freeBlack, 2, 4);
+        if (generateMoves(race.game.board, race.player).size() < 2)
+            continue;
+
+        Engine engine;
+        Move best;
+        REQUIRE(engine.findBestMove(race.game, race.player, best));
+        REQUIRE(engine.solved());
+        CHECK(engine.completedDepth() == race.plies);
+        int margin = race.margin();
+        int blackMargin = race.player == 'B' ? margin : -margin;
+        CHECK((engine.score() > 0) == (blackMargin > 0));
+        CHECK((engine.score() < 0) == (blackMargin < 0));
+        if (margin != 0)
+            ++decisive;
+
+        // выбранный ход сохраняет итог при лучшей игре
+        CHECK(race.marginAfter(best) == margin);
+        const std::vector<Move> &pv = engine.principalVariation();
+        REQUIRE(!pv.empty());
+        CHECK(pv[0] == best);
+    }
+    CHECK(decisive > 0);
+
+    // перебор, не уложившийся в бюджет, уступает место обычному поиску
+    GameState game;
+    game.board = lateRacePosition(rng, 3, 3);
+    game.blackMoves = 5;
+    game.whiteMoves = 5;
+    Engine engine;
+    SearchLimits limits;
+    limits.solverNodes = 1;
+    engine.setLimits(limits);
+    Move best;
+    REQUIRE(engine.findBestMove(game, 'W', best));
+    CHECK_FALSE(engine.solved());
+    CHECK(engine.completedDepth() > 0);
+    CHECK(isValidMove(game.board, best.x1(), best.y1(), best.x2(), best.y2(), 'W'));
+}
+
+TEST_CASE("a pass uses up a move in the game exactly as in the search") {
+    // чёрные заперты в своём углу и каждый свой ход пропускают
+    GameState game;
+    char side;
+    REQUIRE(parsePosition("....WWWW/.....WWW/.....WW./......W./B......./BB....../BBB...../BBBB.... W 2 2",
+                          game, side));
+    Position copy = game.board;
+    const int margin = trueMargin(copy, 'W', game.blackMoves, game.whiteMoves);
+
+    // партия идёт так же, как в main.cpp: ход ИИ или пропуск
+    Engine engine;
+    int turns = 0;
+    while (game.blackMoves > 0 || game.whiteMoves > 0) {
+        int &remaining = side == 'B' ? game.blackMoves : game.whiteMoves;
+        if (remaining > 0) {
+            const int before = remaining;
+            if (!engine.makeAIMove(game, side)) {
+                CHECK(generateMoves(game.board, side).empty());
+                REQUIRE(passTurn(game, side));
+            } else if (turns == 0) {
+                // перебор видел партию до конца с теми же пропусками
+                CHECK(engine.solved());
+                CHECK(engine.completedDepth() == 4);
+            }
+            CHECK(remaining == before - 1);
+            ++turns;
+        }
+        side = side == 'B' ? 'W' : 'B';
+    }
+    CHECK(turns == 4);
+    CHECK(game.moveNumber == 4);
+    CHECK(piecesHome(game.board, 'W') - piecesHome(game.board, 'B') == margin);
+    CHECK_FALSE(passTurn(game, 'B'));
+}
+
+namespace {
+// Сколько фишек attacker доводит до угла при лучшей игре обеих сторон
+int forcedHome(Position &pos, char player, char attacker, int rb, int rw) {
+    char opponent = player == 'B' ? 'W' : 'B';
+    if (rb == 0 && rw == 0)
+        return piecesHome(pos, attacker);
+    if ((player == 'B' ? rb : rw) == 0)
+        return forcedHome(pos, opponent, attacker, rb, rw);
+    int childBlack = rb - (player == 'B' ? 1 : 0);
+    int childWhite = rw - (player == 'W' ? 1 : 0);
+    MoveList moves = generateMoves(pos, player);
+    if (moves.empty())
+        return forcedHome(pos, opponent, attacker, childBlack, childWhite);
+    int best = player == attacker ? 0 : pieces_per_side;
+    for (Move m : moves) {
+        Undo undo;
+        makeMove(pos, m, player, undo);
+        int home = forcedHome(pos, opponent, attacker, childBlack, childWhite);
+        best = player == attacker ? std::max(best, home) : std::min(best, home);
+        unmakeMove(pos, undo, player);
+    }
+    return best;
+}
+} // namespace
+
+TEST_CASE("proof-number search answers forced-home questions exactly") {
+    std::mt19937 rng(23);
+    ProofNumberSearch pns(1);
+    int proven = 0, disproven = 0;
+    for (int trial = 0; trial < 60; ++trial) {
+        LateRace race = lateRace(rng, 1 + int(rng() % 3), 1 + int(rng() % 3), 1, 4);
+        const GameState &game = race.game;
+        const char player = race.player;
+        char attacker = rng() % 2 ? 'B' : 'W';
+        Position copy = game.board;
+        int forced = forcedHome(copy, player, attacker, game.blackMoves, game.whiteMoves);
+        for (int target = forced; target <= forced + 1; ++target) {
+            Move move;
+            ProofResult result = pns.prove(game, player, attacker, ProofGoal::PiecesHome,
+                                           target, 1 << 20, move);
+            REQUIRE(result != ProofResult::Unknown);
+            CHECK((result == ProofResult::Proven) == (forced >= target));
+            if (result == ProofResult::Proven && player == attacker &&
+                piecesHome(game.board, attacker) < target) {
+                ++proven;
+                // доказывающий ход сохраняет цель достижимой
+                REQUIRE(move != Move());
+                Undo undo;
+                makeMove(copy, move, player, undo);
+                CHECK(forcedHome(copy, player == 'B' ? 'W' : 'B', attacker,
+                                 game.blackMoves - (player == 'B'),
+                                 game.whiteMoves - (player == 'W')) >= target);
+                unmakeMove(copy, undo, player);
+            }
+            if (result == ProofResult::Disproven)
+                ++disproven;
+        }
+    }
+    CHECK(proven > 0);
+    CHECK(disproven > 0);
+
+    // вопрос о перевесе: выигрывает ли сторона на ходу
+    int wins = 0;
+    for (int trial = 0; trial < 60; ++trial) {
+        LateRace race = lateRace(rng, 1 + int(rng() % 2), 1 + int(rng() % 2), 1, 4);
+        int margin = race.margin();
+        Move move;
+        ProofResult result =
+            pns.prove(race.game, race.player, race.player, ProofGoal::Margin, 1, 1 << 20, move);
+        REQUIRE(result != ProofResult::Unknown);
+        CHECK((result == ProofResult::Proven) == (margin > 0));
+        if (margin > 0)
+            ++wins;
+    }
+    CHECK(wins > 0);
+
+    // бюджет исчерпан — ответа нет
+    GameState game;
+    game.board = startPosition();
+    Move move;
+    CHECK(pns.prove(game, 'W', 'W', ProofGoal::PiecesHome, pieces_per_side, 100, move) ==
+          ProofResult::Unknown);
+    CHECK(pns.nodes() <= 100);
+    CHECK(pns.prove(game, 'W', 'W', ProofGoal::PiecesHome, pieces_per_side, 1 << 20, move,
+                    [] { return true; }) == ProofResult::Unknown);
+}
+
+TEST_CASE("proof table collects small subtrees when it fills up") {
+    ProofTable table(1);
+    std::mt19937_64 rng(5);
+    uint64_t bigKey = rng() | 1ULL << 63;
+    table.store(bigKey, 1, 1, 1 << 20, 0);
+    for (size_t i = 0; i < 2 * table.capacity(); ++i)
+        table.store(rng() | 1ULL << 63, 1, 1, 1 + uint32_t(rng() % 64), 0);
+    CHECK(table.collections() > 0);
+    CHECK(table.used() < table.capacity());
+    const ProofTable::Entry *e = table.probe(bigKey);
+    REQUIRE(e != nullptr);
+    CHECK(e->work == 1u << 20);
+}
+
+TEST_CASE("engine plays proven wins when the exact solver is off") {
+    std::mt19937 rng(31);
+    int proven = 0;
+    for (int trial = 0; trial < 40; ++trial) {
+        LateRace race = lateRace(rng, 1 + int(rng() % 3), 1 + int(rng() % 3), 3, 5);
+        if (generateMoves(race.game.board, race.player).size() < 2)
+            continue;
+
+        Engine engine;
+        SearchLimits limits;
+        limits.solverNodes = 0;
+        engine.setLimits(limits);
+        Move best;
+        REQUIRE(engine.findBestMove(race.game, race.player, best));
+        if (!engine.solved())
+            continue;
+        ++proven;
+        CHECK(engine.stats().proofNodes > 0);
+        CHECK((race.player == 'B') == (engine.score() > 0));
+        // доказанный ход сохраняет выигрыш
+        CHECK(race.marginAfter(best) > 0);
+    }
+    CHECK(proven > 0);
+}
+
+TEST_CASE("MCTS plays legal lines and finds wins in late races") {
+    GameState game;
+    game.board = startPosition();
+    MctsEngine engine(8);
+    SearchLimits limits;
+    limits.softTimeMs = 60 * 1000;
+    engine.setLimits(limits);
+    engine.setPlayoutLimit(3000);
+    Move best;
+    REQUIRE(engine.findBestMove(game, 'W', best));
+    CHECK(engine.nodes() >= 3000);
+    CHECK(engine.treeSize() > 1);
+    Position pos = game.board;
+    char side = 'W';
+    for (Move m : engine.principalVariation()) {
+        REQUIRE(isValidMove(pos, m.x1(), m.y1(), m.x2(), m.y2(), side));
+        Undo undo;
+        makeMove(pos, m, side, undo);
+        side = side == 'B' ? 'W' : 'B';
+    }
+    CHECK(engine.principalVariation()[0] == best);
+
+    // выигрышный ход находится там, где он есть
+    std::mt19937 rng(41);
+    int winning = 0;
+    for (int trial = 0; trial < 30; ++trial) {
+        LateRace race = lateRace(rng, 1 + int(rng() % 2), 1 + int(rng() % 2), 3, 3);
+        if (generateMoves(race.game.board, 'B').size() < 2 || race.margin() <= 0)
+            continue;
+        ++winning;
+        MctsEngine mcts(8);
+        mcts.setLimits(limits);
+        mcts.setPlayoutLimit(2000);
+        REQUIRE(mcts.findBestMove(race.game, 'B', best));
+        CHECK(mcts.score() > 0);
+        CHECK(race.marginAfter(best) > 0);
+    }
+    CHECK(winning > 0);
+}
+
+TEST_CASE("MCTS reuses its tree and removes every virtual loss") {
+    GameState game;
+    game.board = startPosition();
+    MctsEngine engine(8);
+    SearchLimits limits;
+    limits.softTimeMs = 60 * 1000;
+    engine.setLimits(limits);
+    engine.setThreads(4);
+    engine.setPlayoutLimit(2000);
+    Move best;
+    REQUIRE(engine.findBestMove(game, 'W', best));
+    CHECK(engine.reusedVisits() == 0);
+    // та же позиция: в корне ровно по посещению на каждую симуляцию
+    uint64_t first = engine.nodes();
+    REQUIRE(engine.findBestMove(game, 'W', best));
+    CHECK(engine.reusedVisits() == first);
+
+    // после своего хода и ответа соперника поиск продолжает поддерево
+    REQUIRE(engine.makeAIMove(game, 'W'));
+    const std::vector<Move> &pv = engine.principalVariation();
+    REQUIRE(pv.size() >= 2);
+    Move reply = pv[1];
+    REQUIRE(makeMove(game.board, reply.x1(), reply.y1(), reply.x2(), reply.y2(), 'B'));
+    game.blackMoves--;
+    REQUIRE(engine.findBestMove(game, 'W', best));
+    CHECK(engine.reusedVisits() > 0);
+    CHECK(isValidMove(game.board, best.x1(), best.y1(), best.x2(), best.y2(), 'W'));
+}
+
+TEST_CASE("alpha-beta and MCTS play each other through the common interface") {
+    GameState game;
+    game.board = startPosition();
+    Engine alphaBeta;
+    MctsEngine mcts(8);
+    SearchLimits limits;
+    limits.softTimeMs = 5;
+    limits.hardTimeMs = 10;
+    alphaBeta.setLimits(limits);
+    mcts.setLimits(limits);
+    SearchEngine *players[2] = {&alphaBeta, &mcts};
+    while (game.whiteMoves > 0 || game.blackMoves > 0) {
+        if (game.whiteMoves > 0 && !players[0]->makeAIMove(game, 'W'))
+            CHECK(passTurn(game, 'W'));
+        if (game.blackMoves > 0 && !players[1]->makeAIMove(game, 'B'))
+            CHECK(passTurn(game, 'B'));
+    }
+    CHECK(game.moveNumber == 40);
+    CHECK(popCount(game.board.white) == 10);
+    CHECK(popCount(game.board.black) == 10);
+
+    // оба движка отвечают одинаково и при исчерпанном счётчике стороны
+    GameState spent;
+    spent.board = startPosition();
+    spent.whiteMoves = 0;
+    for (SearchEngine *engine : players) {
+        Move best;
+        REQUIRE(engine->findBestMove(spent, 'W', best));
+        CHECK(isValidMove(spent.board, best.x1(), best.y1(), best.x2(), best.y2(), 'W'));
+    }
+}
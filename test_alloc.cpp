@@ -0,0 +1,113 @@
+// Поиск не должен обращаться к куче: все операторы new/delete программы
+// заменены считающими, и после создания движка счётчик обязан стоять
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "ai.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifndef UGOLKI_BENCH_CORPUS
+#define UGOLKI_BENCH_CORPUS "bench_positions.txt"
+#endif
+
+namespace {
+std::atomic<bool> counting{false};
+std::atomic<uint64_t> allocations{0};
+std::atomic<uint64_t> allocatedBytes{0};
+
+void *allocate(std::size_t size) {
+    if (counting.load(std::memory_order_relaxed)) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *allocateAligned(std::size_t size, std::align_val_t alignment) {
+    if (counting.load(std::memory_order_relaxed)) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    const std::size_t align = static_cast<std::size_t>(alignment);
+    // aligned_alloc требует размер, кратный выравниванию
+    if (void *p = std::aligned_alloc(align, (size + align - 1) / align * align))
+        return p;
+    throw std::bad_alloc();
+}
+
+// Счёт allocations только на время объекта
+struct AllocationScope {
+    AllocationScope() {
+        allocations = 0;
+        allocatedBytes = 0;
+        counting = true;
+    }
+    ~AllocationScope() { counting = false; }
+};
+} // namespace
+
+void *operator new(std::size_t size) { return allocate(size); }
+void *operator new[](std::size_t size) { return allocate(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    return allocateAligned(size, alignment);
+}
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+    return allocateAligned(size, alignment);
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+TEST_CASE("fixed-depth search does not touch the heap") {
+    std::vector<CorpusEntry> positions;
+    REQUIRE(loadCorpus(UGOLKI_BENCH_CORPUS, positions));
+    REQUIRE(!positions.empty());
+
+    Engine engine;
+    SearchLimits limits;
+    limits.maxDepth = 5;
+    limits.softTimeMs = limits.hardTimeMs = 3600 * 1000;
+    engine.setLimits(limits);
+
+    for (const auto &entry : positions) {
+        Move best;
+        bool found;
+        {
+            AllocationScope scope;
+            found = engine.findBestMove(entry.game, entry.side, best);
+        }
+        INFO("position " << positionToString(entry.game, entry.side));
+        CHECK(found);
+        CHECK(allocations.load() == 0);
+        CHECK(allocatedBytes.load() == 0);
+    }
+}
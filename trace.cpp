@@ -0,0 +1,134 @@
+#include "trace.h"
+
+#ifdef UGOLKI_TRACE
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "ai.h"
+
+namespace {
+constexpr uint64_t kCapacity = 1 << 18;
+
+const char *const kEventNames[] = {
+    "makeAIMove", "search",   "solve",  "prove",       "iteration", "root move",
+    "abort",      "deadline", "helper", "split point", "tt resize"};
+static_assert(sizeof(kEventNames) / sizeof(kEventNames[0]) ==
+                  size_t(TraceEvent::Count),
+              "name for every event");
+
+// Ячейка кольца. Писатель обнуляет номер, пишет поля и публикует номер
+// записи плюс один; читатель берёт ячейку, только если номер до и после
+// чтения полей совпал с ожидаемым
+struct Slot {
+  std::atomic<uint64_t> sequence{0};
+  std::atomic<uint64_t> ns{0};
+  std::atomic<int64_t> arg{0};
+  // событие, фаза и номер потока
+  std::atomic<uint64_t> meta{0};
+};
+
+Slot ring[kCapacity];
+std::atomic<uint64_t> head{0};
+std::atomic<uint32_t> threadCount{0};
+// Начало отсчёта — первое событие: движок может писать события ещё при
+// инициализации глобальных объектов
+std::chrono::steady_clock::time_point traceStart() {
+  static const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  return start;
+}
+
+uint32_t threadNumber() {
+  thread_local uint32_t number =
+      threadCount.fetch_add(1, std::memory_order_relaxed) + 1;
+  return number;
+}
+
+// Аргументы события в JSON; ход записывается нотацией доски
+std::string formatArgs(TraceEvent event, int64_t arg) {
+  switch (event) {
+  case TraceEvent::MakeAIMove:
+  case TraceEvent::Search:
+    return "{\"player\":\"" + std::string(1, char(arg)) + "\"}";
+  case TraceEvent::RootMove:
+    return "{\"move\":\"" + moveToString(Move(uint16_t(arg))) + "\"}";
+  case TraceEvent::Deadline:
+    return "{\"nodes\":" + std::to_string(arg) + "}";
+  case TraceEvent::Helper:
+    return "{\"worker\":" + std::to_string(arg) + "}";
+  case TraceEvent::SplitPoint:
+    return "{\"ply\":" + std::to_string(arg) + "}";
+  case TraceEvent::TTResize:
+    return "{\"mb\":" + std::to_string(arg) + "}";
+  case TraceEvent::Solve:
+  case TraceEvent::Prove:
+    return "{\"horizon\":" + std::to_string(arg) + "}";
+  default:
+    return "{\"depth\":" + std::to_string(arg) + "}";
+  }
+}
+} // namespace
+
+void trace::record(TraceEvent event, char phase, int64_t arg) {
+  const uint64_t ns = uint64_t(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - traceStart())
+          .count());
+  const uint64_t index = head.fetch_add(1, std::memory_order_relaxed);
+  Slot &slot = ring[index & (kCapacity - 1)];
+  slot.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.ns.store(ns, std::memory_order_relaxed);
+  slot.arg.store(arg, std::memory_order_relaxed);
+  slot.meta.store(uint64_t(event) | uint64_t(uint8_t(phase)) << 8 |
+                      uint64_t(threadNumber()) << 16,
+                  std::memory_order_relaxed);
+  slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+bool writeTrace(const char *path) {
+  std::FILE *out = std::fopen(path, "w");
+  if (!out)
+    return false;
+  std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", out);
+  const uint64_t last = head.load(std::memory_order_acquire);
+  const uint64_t first = last > kCapacity ? last - kCapacity : 0;
+  bool comma = false;
+  for (uint64_t index = first; index < last; ++index) {
+    const Slot &slot = ring[index & (kCapacity - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != index + 1)
+      continue;
+    const uint64_t ns = slot.ns.load(std::memory_order_relaxed);
+    const int64_t arg = slot.arg.load(std::memory_order_relaxed);
+    const uint64_t meta = slot.meta.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != index + 1)
+      continue;
+    const int event = int(meta & 0xFF);
+    const char phase = char((meta >> 8) & 0xFF);
+    if (event >= int(TraceEvent::Count))
+      continue;
+    std::fprintf(out,
+                 "%s\n{\"name\":\"%s\",\"ph\":\"%c\",%s\"ts\":%.3f,"
+                 "\"pid\":1,\"tid\":%u,\"args\":%s}",
+                 comma ? "," : "", kEventNames[event], phase,
+                 phase == 'i' ? "\"s\":\"t\"," : "", double(ns) / 1000.0,
+                 unsigned(meta >> 16),
+                 formatArgs(TraceEvent(event), arg).c_str());
+    comma = true;
+  }
+  std::fputs("\n]}\n", out);
+  return std::fclose(out) == 0;
+}
+
+void clearTrace() {
+  for (Slot &slot : ring)
+    slot.sequence.store(0, std::memory_order_relaxed);
+  head.store(0, std::memory_order_release);
+}
+#else
+bool writeTrace(const char *) { return false; }
+void clearTrace() {}
+#endif
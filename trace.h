@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+
+// События временной шкалы поиска для Chrome trace / Perfetto. Запись
+// собирается только с UGOLKI_TRACE (опция CMake того же имени); без него
+// макросы UGOLKI_TRACE_* пусты и ничего не стоят
+enum class TraceEvent : uint8_t {
+  MakeAIMove, // ход ИИ целиком; аргумент — сторона
+  Search,     // поиск позиции; аргумент — сторона
+  Solve,      // точный перебор конца партии; аргумент — горизонт
+  Prove,      // доказательство выигрыша; аргумент — горизонт
+  Iteration,  // итерация углубления; аргумент — глубина
+  RootMove,   // перебор хода в корне; аргумент — ход
+  Abort,      // итерация отброшена по остановке; аргумент — глубина
+  Deadline,   // жёсткий срок вышел; аргумент — узлы потока
+  Helper,     // работа помощника; аргумент — номер потока
+  SplitPoint, // помощь в точке разделения YBWC; аргумент — полуход
+  TTResize,   // новый размер таблицы транспозиций; аргумент — мегабайты
+  Count
+};
+
+#ifdef UGOLKI_TRACE
+namespace trace {
+// Фаза события в терминах Chrome trace: 'B', 'E' или 'i'
+void record(TraceEvent event, char phase, int64_t arg);
+
+// Пара событий начала и конца на время жизни объекта
+struct Scope {
+  Scope(TraceEvent event, int64_t arg) : event(event), arg(arg) {
+    record(event, 'B', arg);
+  }
+  ~Scope() { record(event, 'E', arg); }
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+  TraceEvent event;
+  int64_t arg;
+};
+} // namespace trace
+
+#define UGOLKI_TRACE_CONCAT_(a, b) a##b
+#define UGOLKI_TRACE_CONCAT(a, b) UGOLKI_TRACE_CONCAT_(a, b)
+#define UGOLKI_TRACE_SCOPE(event, arg)                                         \
+  trace::Scope UGOLKI_TRACE_CONCAT(traceScope_, __LINE__)(TraceEvent::event,  \
+                                                          int64_t(arg))
+#define UGOLKI_TRACE_BEGIN(event, arg)                                         \
+  trace::record(TraceEvent::event, 'B', int64_t(arg))
+#define UGOLKI_TRACE_END(event, arg)                                           \
+  trace::record(TraceEvent::event, 'E', int64_t(arg))
+#define UGOLKI_TRACE_INSTANT(event, arg)                                       \
+  trace::record(TraceEvent::event, 'i', int64_t(arg))
+#else
+#define UGOLKI_TRACE_SCOPE(event, arg) ((void)0)
+#define UGOLKI_TRACE_BEGIN(event, arg) ((void)0)
+#define UGOLKI_TRACE_END(event, arg) ((void)0)
+#define UGOLKI_TRACE_INSTANT(event, arg) ((void)0)
+#endif
+
+// Последние события всех потоков (кольцевой буфер держит 256K событий) в
+// формате Chrome trace JSON. false — файл не записан или сборка без
+// UGOLKI_TRACE. Пока идёт запись, события продолжают поступать; успевшие
+// перезаписаться пропускаются
+bool writeTrace(const char *path);
+// Забывает накопленные события; вызывать, пока поиск не идёт
+void clearTrace();
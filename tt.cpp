@@ -0,0 +1,91 @@
+#include "tt.h"
+#include "trace.h"
+
+namespace {
+// Раскладка данных записи:
+// биты 0-15 — ход, 16-47 — оценка, 48-55 — глубина, 56-57 — тип оценки,
+// 58-63 — поколение поиска
+uint64_t pack(uint16_t move, int score, int depth, Bound bound,
+              uint8_t generation) {
+  return uint64_t(move) | uint64_t(uint32_t(score)) << 16 |
+         uint64_t(uint8_t(depth)) << 48 | uint64_t(bound) << 56 |
+         uint64_t(generation) << 58;
+}
+
+uint16_t moveOf(uint64_t data) { return uint16_t(data); }
+int scoreOf(uint64_t data) { return int32_t(uint32_t(data >> 16)); }
+int depthOf(uint64_t data) { return int(uint8_t(data >> 48)); }
+Bound boundOf(uint64_t data) { return Bound((data >> 56) & 3); }
+uint8_t generationOf(uint64_t data) { return uint8_t(data >> 58); }
+} // namespace
+
+TranspositionTable::TranspositionTable(size_t sizeMb) { resize(sizeMb); }
+
+void TranspositionTable::resize(size_t sizeMb) {
+  if (sizeMb == 0)
+    sizeMb = 1;
+  UGOLKI_TRACE_SCOPE(TTResize, sizeMb);
+  // число корзин — наибольшая степень двойки, помещающаяся в sizeMb
+  size_t count = 1;
+  while (count * 2 * sizeof(Bucket) <= sizeMb * 1024 * 1024)
+    count *= 2;
+  buckets_.reset(new Bucket[count]);
+  mask_ = count - 1;
+  sizeMb_ = sizeMb;
+  generation_ = 0;
+}
+
+void TranspositionTable::clear() {
+  for (size_t i = 0; i <= mask_; ++i)
+    for (Entry &e : buckets_[i].entries) {
+      e.check.store(0, std::memory_order_relaxed);
+      e.data.store(0, std::memory_order_relaxed);
+    }
+  generation_ = 0;
+}
+
+bool TranspositionTable::probe(uint64_t key, TTHit &hit) const {
+  for (const Entry &e : bucketFor(key).entries) {
+    uint64_t data = e.data.load(std::memory_order_relaxed);
+    uint64_t check = e.check.load(std::memory_order_relaxed);
+    if ((check ^ data) != key || boundOf(data) == Bound::None)
+      continue;
+    hit.move = moveOf(data);
+    hit.score = scoreOf(data);
+    hit.depth = depthOf(data);
+    hit.bound = boundOf(data);
+    return true;
+  }
+  return false;
+}
+
+void TranspositionTable::store(uint64_t key, int depth, Bound bound, int score,
+                               uint16_t move) {
+  Bucket &bucket = bucketFor(key);
+  Entry *replace = &bucket.entries[0];
+  int worst = 1 << 30;
+  for (Entry &e : bucket.entries) {
+    uint64_t data = e.data.load(std::memory_order_relaxed);
+    uint64_t check = e.check.load(std::memory_order_relaxed);
+    if ((check ^ data) == key) {
+      // та же позиция: мелкий неточный результат не затирает глубокий
+      if (depth < depthOf(data) && bound != Bound::Exact &&
+          generationOf(data) == generation_)
+        return;
+      if (move == 0)
+        move = moveOf(data);
+      replace = &e;
+      break;
+    }
+    // вытесняем самую мелкую запись, записи прошлых поисков — в первую очередь
+    int age = (generation_ - generationOf(data)) & kGenerationMask;
+    int value = depthOf(data) - 8 * age;
+    if (value < worst) {
+      worst = value;
+      replace = &e;
+    }
+  }
+  uint64_t data = pack(move, score, depth, bound, generation_);
+  replace->data.store(data, std::memory_order_relaxed);
+  replace->check.store(key ^ data, std::memory_order_relaxed);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Тип оценки в таблице: точная, верхняя или нижняя граница
+enum class Bound : uint8_t { None = 0, Upper = 1, Lower = 2, Exact = 3 };
+
+// Результат пробы таблицы. Ход упакован: from | to << 6 (0 — хода нет)
+struct TTHit {
+  int score;
+  int depth;
+  Bound bound;
+  uint16_t move;
+};
+
+// Таблица транспозиций фиксированного размера. Корзина из четырёх записей
+// занимает одну кэш-линию. Запись хранит ключ XOR данные, поэтому потоки
+// пишут и читают её без блокировок: разорванная запись не пройдёт проверку
+class TranspositionTable {
+public:
+  explicit TranspositionTable(size_t sizeMb = 16);
+
+  // Новый размер в мегабайтах; содержимое очищается
+  void resize(size_t sizeMb);
+  void clear();
+  // Начало нового поиска: старые записи вытесняются первыми
+  void newSearch() { generation_ = (generation_ + 1) & kGenerationMask; }
+
+  bool probe(uint64_t key, TTHit &hit) const;
+  void store(uint64_t key, int depth, Bound bound, int score, uint16_t move);
+
+  size_t sizeMb() const { return sizeMb_; }
+
+private:
+  static constexpr int kBucketSize = 4;
+  static constexpr uint8_t kGenerationMask = 0x3F;
+
+  struct Entry {
+    std::atomic<uint64_t> check{0}; // ключ XOR data
+    std::atomic<uint64_t> data{0};
+  };
+  struct alignas(64) Bucket {
+    Entry entries[kBucketSize];
+  };
+  static_assert(sizeof(Bucket) == 64, "корзина должна занимать кэш-линию");
+
+  Bucket &bucketFor(uint64_t key) const { return buckets_[key & mask_]; }
+
+  std::unique_ptr<Bucket[]> buckets_;
+  size_t mask_ = 0;
+  size_t sizeMb_ = 0;
+  uint8_t generation_ = 0;
+};